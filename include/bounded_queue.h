@@ -0,0 +1,83 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/*
+- Lock-free bounded multi producer / multi consumer queue (D. Vyukov's array queue)
+- Every cell carries a sequence number that tells whether it is ready to be written or read,
+- so producers and consumers only contend on their own position counter.
+- tryPush fails when the queue is full; that is where backpressure comes from.
+*/
+template <typename T>
+class BoundedQueue {
+public:
+    //capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t requested) {
+        size_t capacity = 2;
+        while (capacity < requested) capacity *= 2;
+        mask = capacity - 1;
+        cells.reset(new Cell[capacity]);
+        for (size_t i = 0; i < capacity; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool tryPush(const T& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) return false; //full
+            else pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPop(T& value) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) return false; //empty
+            else pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    //only a snapshot while other threads are pushing or popping
+    size_t size() const {
+        size_t tail = dequeuePos.load(std::memory_order_relaxed);
+        size_t head = enqueuePos.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    //the two counters live on separate cache lines so producers and consumers do not share one
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+};
+
+#endif
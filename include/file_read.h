@@ -2,7 +2,8 @@
 #define FILE_READ_H
 #include <string>
 #include <vector>
-#include "constants.h"
+#include <istream>
+#include "lidar_types.h"
 
 //downloading TOML file from URL and saves it locally
 bool downloadTomlFile(const std::string& url, const std::string& localPath);
@@ -11,5 +12,12 @@ Scan readScan(const std::string& filename);
 std::vector<double> readRanges(const std::string& filename);
 std::vector<double> readIntensities(const std::string& filename);
 
+//stream versions, for scans that are not a whole file of their own
+Header readHeader(std::istream& file);
+Scan readScan(std::istream& file);
+std::vector<double> readRanges(std::istream& file);
+std::vector<double> readIntensities(std::istream& file);
+std::vector<std::string> readFrameBlocks(const std::string& filename);
+
 #endif
 
@@ -0,0 +1,54 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+#include <cstdint>
+#include <string>
+
+/*
+- Hot path instrumentation: scoped timers and counters, a summary table and a Chrome trace file
+- Build with -DLIDAR_INSTRUMENT to turn it on; without it the macros expand to nothing
+- and the report functions only say that instrumentation is off.
+- Each thread records into its own buffer, so timing a scope takes two clock reads and no lock.
+- Reports read every thread's buffer, call them once the worker threads have stopped.
+- Open the trace file in chrome://tracing or ui.perfetto.dev
+*/
+enum InstrumentCounter {
+    CounterIterations,      //RANSAC samples drawn
+    CounterCandidates,      //candidate lines scored against the points
+    CounterRejectedEarly,   //candidate lines dropped by the sequential test
+    CounterInliersTested,   //point to line distance checks
+    CounterAllocations,     //heap allocations, all threads
+    CounterCount
+};
+
+#ifdef LIDAR_INSTRUMENT
+
+//times the enclosing scope, name must be a string literal
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* name);
+    ~ScopedTimer();
+private:
+    const char* name;
+    std::int64_t startNs;
+};
+
+void instrumentCount(InstrumentCounter counter, std::uint64_t amount);
+
+#define LIDAR_CONCAT_INNER(a, b) a##b
+#define LIDAR_CONCAT(a, b) LIDAR_CONCAT_INNER(a, b)
+#define LIDAR_SCOPE(name) ScopedTimer LIDAR_CONCAT(lidarScope, __LINE__)(name)
+#define LIDAR_COUNT(counter, amount) instrumentCount(counter, amount)
+
+#else
+
+#define LIDAR_SCOPE(name) ((void)0)
+#define LIDAR_COUNT(counter, amount) ((void)0)
+
+#endif
+
+void printInstrumentSummary();
+bool writeChromeTrace(const std::string& filename);
+//summary on the console and the trace into filename, for the end of a run
+void finishInstrumentation(const std::string& traceFile);
+
+#endif
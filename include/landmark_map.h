@@ -0,0 +1,83 @@
+#ifndef LANDMARK_MAP_H
+#define LANDMARK_MAP_H
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "lidar_types.h"
+#include "scan_match.h"
+
+/*
+- Corners seen over many frames, kept in map coordinates
+- Each frame's intersections are moved into the map with the frame's pose. An intersection close to a
+- known corner with a similar angle is averaged into it, anything else becomes a new corner.
+- Corners are bucketed by position in a hash of square cells one merge radius wide, so a lookup only
+- visits the cells around it. The number of corners grows with the size of the area, not the number
+- of frames; corners seen only once are dropped again after a while, so noise does not pile up either.
+- A corner that moves within the merge radius of another one with a similar angle absorbs it, so a
+- corner placed twice by a drifting pose becomes one again once the poses agree. This only bounds the
+- map while the drift between two visits stays below the merge radius; the caller should not pass
+- frames whose pose is known to be wrong.
+*/
+struct LandmarkConfig {
+    double mergeRadius = 0.15;      //metres, observations closer than this to a corner are the same corner
+    double angleTolerance = 15.0;   //degrees the corner angle may differ by and still merge
+    int maxWeight = 50;             //older observations fade once a corner has this many, so it can follow drift
+    int confirmObservations = 3;    //corners seen fewer times are forgotten after forgetFrames
+    unsigned long forgetFrames = 100;
+};
+
+struct Landmark {
+    Point2D point;              //averaged position in the map
+    double angle_degrees;       //averaged angle between the two walls
+    int observations;           //0 for a free slot
+    unsigned long firstSeen;    //frame numbers as passed to observe()
+    unsigned long lastSeen;
+};
+
+class LandmarkMap {
+public:
+    explicit LandmarkMap(const LandmarkConfig& config = LandmarkConfig());
+
+    //intersections in the sensor frame, pose is the sensor in the map; ids[i] is the corner
+    //intersections[i] was merged into, returns how many corners are new
+    int addObservations(const Pose2D& pose, const std::vector<Intersection>& intersections,
+                        unsigned long frame, std::vector<int>& ids);
+    //one observation in map coordinates, returns the id of the corner it belongs to
+    int observe(const Point2D& point, double angle_degrees, unsigned long frame);
+
+    //ids of all corners within radius of (x, y)
+    void findInRadius(double x, double y, double radius, std::vector<int>& ids) const;
+    //closest corner within radius, -1 if there is none
+    int nearest(double x, double y, double radius) const;
+
+    //ids are indices into this; they stay valid until the corner is forgotten
+    const std::vector<Landmark>& landmarks() const { return items; }
+    size_t size() const { return items.size() - freeSlots.size(); }
+    size_t confirmedCount() const;
+    void clear();
+    const LandmarkConfig& settings() const { return config; }
+
+private:
+    std::uint64_t cellOf(double x, double y) const;
+    void insertIntoCell(std::uint64_t cell, int id);
+    void removeFromCell(std::uint64_t cell, int id);
+    void forgetStale(unsigned long frame);
+    void absorbNeighbours(int id);
+    void release(int id);
+
+    LandmarkConfig config;
+    double inverseCell;
+    std::unordered_map<std::uint64_t, std::vector<int>> cells;
+    std::vector<Landmark> items;
+    std::vector<int> freeSlots;
+    std::vector<int> nearby;    //scratch for absorbNeighbours
+    unsigned long lastForget = 0;
+};
+
+//one line per corner: id x y angle observations
+bool writeLandmarks(const LandmarkMap& map, const std::string& filename);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef LIDAR_API_H
+#define LIDAR_API_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lidar_types.h"
+
+/*
+- Embedding API for processes that already hold ranges in memory, such as a sensor driver
+- Only depends on the core (lidar_types, operations), no SFML and no curl
+- Ranges are read where they are; results go into storage the caller owns and reuses
+*/
+
+//read-only view over ranges owned by the caller, nothing is copied
+template <typename T>
+struct RangeView {
+    const T* data;
+    size_t size;
+};
+
+//how each frame is processed
+struct PipelineConfig {
+    RANSACparameters ransac;
+    double minAngleThreshold = 60.0;    //passed to findValidIntersections
+    int detectionBudgetMs = 500;        //wall-clock budget for detectLines, 0 means no limit
+    bool buildTrees = false;            //quadtrees for drawing, only set where the frame is drawn
+};
+
+//caller-owned results; keep one around and pass it every frame so its memory is reused
+struct LidarOutput {
+    std::vector<Point2D> points;
+    std::vector<Line> lines;
+    std::vector<Intersection> intersections;
+    RANSACstats stats;
+};
+
+size_t lidarConvert(RangeView<double> ranges, const Scan& scan, Point2D* points, size_t capacity);
+size_t lidarConvert(RangeView<float> ranges, const Scan& scan, Point2D* points, size_t capacity);
+void lidarProcess(RangeView<double> ranges, const Scan& scan, const PipelineConfig& config, LidarOutput& output);
+void lidarProcess(RangeView<float> ranges, const Scan& scan, const PipelineConfig& config, LidarOutput& output);
+//16 bit fixed point ranges as in quantized.h, metres = value * scale
+size_t lidarConvert(RangeView<std::uint16_t> ranges, float scale, const Scan& scan, Point2D* points, size_t capacity);
+void lidarProcess(RangeView<std::uint16_t> ranges, float scale, const Scan& scan, const PipelineConfig& config,
+                  LidarOutput& output);
+
+#endif
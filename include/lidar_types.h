@@ -0,0 +1,89 @@
+#ifndef LIDAR_TYPES_H
+#define LIDAR_TYPES_H
+#include <vector>
+#include <string>
+#include <chrono>
+
+//data types shared by the whole program, with no SFML or curl dependency so the core can be built on its own
+
+//Struct for holding x and y positions of each dot
+struct Point2D {
+    double x;
+    double y;
+};
+
+//using ax + by + c 
+//we keep the line, also the dots that make up the line in this structure
+struct Line {
+    double a, b, c;
+    std::vector<int> pointIndices;
+};
+
+//how findBestLineRANSAC picks the two points of a candidate
+enum class SamplingMode {
+    Uniform,    //both anywhere among the available points
+    Local       //the second one within sampleWindow points of the first in scan order, so both tend to sit on one wall
+};
+
+struct RANSACparameters {
+    int minPoints = 8;  //minimum points required to form a line
+    double distanceThreshold = 0.05;  //max distance for point to be on the line
+    int maxIterations = 1000;   //number of random samples to try per line
+    bool earlyRejection = false; //sequential test drops hopeless candidates after a few points instead of scoring all
+    SamplingMode sampling = SamplingMode::Uniform;
+    int sampleWindow = 16;      //neighbourhood for Local, in available points either side
+    double confidence = 0;      //above 0, e.g. 0.99: stop once a line as good as the best would have been drawn with
+                                //this probability; 0 always runs maxIterations
+};
+
+//point in time after which RANSAC stops searching and returns what it has
+typedef std::chrono::steady_clock::time_point Deadline;
+
+//how far a (possibly time-budgeted) RANSAC run got
+struct RANSACstats {
+    bool partial = false;       //true if the deadline passed before the search finished
+    bool cancelled = false;     //stopped by the caller's cancel flag, the result is not worth keeping
+    int iterations = 0;         //random samples actually tried
+    int candidatesScored = 0;   //candidates that went through full inlier scoring
+    int rejectedEarly = 0;      //candidates dropped by the sequential test before seeing every point
+    long long iterationsToFind = 0; //iterations until a candidate had 90% of the final line's inliers, summed over the lines
+    long long pointsTested = 0; //point to line checks, the test's and the full scoring's
+    int linesFound = 0;         //lines accepted before stopping
+    int pointsRemaining = 0;    //points not assigned to any line when stopped
+    double elapsedMs = 0;       //wall-clock time spent
+};
+
+struct Intersection {
+    Point2D point;  // The (x, y) location where lines intersect
+    int line1_idx;  // Index of first line in the lines array
+    int line2_idx;  // Index of second line in the lines array
+    double angle_degrees;   // Angle between the two lines (0-90 degrees)
+    double distance_to_robot;   // Distance from robot (at origin) to intersection point
+};
+
+const float almostZero = 1e-10;
+#define M1_P 3.14159265358
+//--------------------------------------
+//--------------------------------------
+
+#define HEADER "[header]"
+#define ERROR_VECTOR {-8.8}
+
+struct Header {
+    std::string stamp;
+    std::string frame_id; 
+};
+
+struct Scan {
+    double angle_min;
+    double angle_max;
+    double angle_increment;
+
+    double time_increment;
+    double scan_time;
+
+    double range_min;
+    double range_max;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef MULTI_SENSOR_H
+#define MULTI_SENSOR_H
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+#include "pipeline.h"
+
+//where a sensor sits on the robot, maps its points into the common (robot) frame
+struct Extrinsic {
+    double x = 0, y = 0;    //position in metres
+    double yaw = 0;         //rotation in radians, counter-clockwise
+};
+
+//where line detection runs
+enum class FusionMode {
+    Fused,      //once, on the merged cloud of every sensor; finds walls that several sensors see
+    PerSensor   //on each sensor's worker, results are transformed and merged; lower latency
+};
+
+//one sensor's share of a fused frame
+struct SensorStatus {
+    std::string frameId;
+    std::string stamp;
+    size_t points = 0;
+    double processMs = 0;   //conversion, transform and (per sensor mode) detection of its last frame
+    bool fresh = false;     //a new frame since the previous fused one
+};
+
+//a fused frame: result.points holds every sensor's points in the common frame
+struct FusedFrame {
+    FrameResult result;
+    std::vector<SensorStatus> sensors;
+    double fuseMs = 0;      //merging, and in fused mode detection
+    double latencyMs = 0;   //from the start of the oldest sensor frame in it until it was published
+};
+
+/*
+- Reads a table of static extrinsics, one line per frame_id:
+-   frame_id = x y yaw_degrees
+- Lines starting with # or [ are ignored. Frames with an unknown frame_id are used as they are.
+*/
+bool readExtrinsics(const std::string& filename, std::map<std::string, Extrinsic>& extrinsics);
+void transformPoints(const Extrinsic& extrinsic, Point2D* points, size_t count);
+//moves a processed frame, points, lines and intersections, into the common frame
+void transformResult(const Extrinsic& extrinsic, FrameResult& result);
+
+//every sensor is read and processed on its own thread, a fusion thread merges their latest frames
+class MultiSensorWorker {
+public:
+    MultiSensorWorker(const std::vector<FrameSource>& sources, const std::map<std::string, Extrinsic>& extrinsics,
+                      const PipelineConfig& config, FusionMode mode);
+    ~MultiSensorWorker();
+
+    void start();
+    void stop();
+    //settings for the frames that start after this call
+    void setConfig(const PipelineConfig& config);
+
+    //same contract as ProcessingWorker
+    bool update();
+    const FusedFrame& latest() const;
+    FusedFrame& latest();
+
+    //a sensor that stops sending does not hold the others back for longer than this
+    int maxWaitMs = 500;
+
+private:
+    //what a sensor thread hands to the fusion thread
+    struct SensorFrame {
+        FrameResult result;     //already in the common frame
+        SensorStatus status;
+        double startedAt = 0;   //steady clock seconds when the frame was picked up
+    };
+    struct Sensor {
+        FrameSource source;
+        TripleBuffer<SensorFrame> frames;
+        std::thread thread;
+    };
+
+    void runSensor(Sensor& sensor);
+    void runFusion();
+    PipelineConfig currentConfig();
+    Extrinsic extrinsicFor(const std::string& frameId) const;
+
+    std::vector<std::unique_ptr<Sensor>> sensors;
+    std::map<std::string, Extrinsic> extrinsics;
+    PipelineConfig config;
+    std::mutex configMutex;
+    FusionMode mode;
+    TripleBuffer<FusedFrame> fused;
+    std::thread fusionThread;
+    std::atomic<bool> running{false};
+    unsigned long sequence = 0;
+
+    //sensors wake the fusion thread when they publish
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    unsigned long published = 0;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef NET_INGEST_H
+#define NET_INGEST_H
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "lidar_types.h"
+
+/*
+- Binary scan protocol, little endian, one scan per UDP datagram or back to back on a TCP stream:
+-   ScanPacketHeader (136 bytes) followed by rangeCount float32 ranges
+- The header carries the same fields as Header and Scan
+*/
+const std::uint32_t scanPacketMagic = 0x3152444C; //"LDR1"
+const std::uint16_t scanPacketVersion = 1;
+const size_t maxDatagramSize = 65507;   //largest UDP payload over IPv4, no scan packet can be bigger
+
+struct ScanPacketHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t headerSize;   //sizeof(ScanPacketHeader), lets newer senders append fields
+    std::uint32_t sequence;
+    std::uint32_t rangeCount;
+    char stamp[32];             //zero padded, not necessarily zero terminated
+    char frameId[32];
+    double angle_min;
+    double angle_max;
+    double angle_increment;
+    double time_increment;
+    double scan_time;
+    double range_min;
+    double range_max;
+};
+static_assert(sizeof(ScanPacketHeader) == 136, "ScanPacketHeader must have no padding");
+
+enum class IngestProtocol { Udp, Tcp };
+
+struct IngestConfig {
+    IngestProtocol protocol = IngestProtocol::Udp;
+    unsigned short port = 5600;
+    size_t slotCount = 64;      //ring buffer slots, each holds one whole packet
+    size_t maxBeams = 16384;    //largest scan accepted over TCP, sizes the slots; UDP slots stop at maxDatagramSize
+    bool latestOnly = true;     //hand out only the newest waiting scan, older ones count as stale
+};
+
+size_t scanPacketSize(size_t rangeCount);
+//bytes one ring slot needs for this configuration
+size_t ingestSlotSize(const IngestConfig& config);
+size_t encodeScanPacket(const Header& header, const Scan& scan, const std::vector<double>& ranges,
+                        std::uint32_t sequence, std::vector<char>& packet);
+bool decodeScanPacket(const char* packet, size_t size, Header& header, Scan& scan,
+                      const float*& ranges, size_t& rangeCount);
+
+//receives scans on a local socket into a preallocated ring, the pipeline decodes them in place
+class NetIngest {
+public:
+    explicit NetIngest(const IngestConfig& config);
+    ~NetIngest();
+
+    bool start();
+    void stop();
+
+    //converts the next waiting scan straight from its slot into points, false if nothing arrived in time
+    bool decodeNext(Header& header, Scan& scan, std::vector<Point2D>& points, int timeoutMs = 20);
+
+    std::uint64_t received() const { return receivedCount; }
+    std::uint64_t dropped() const { return droppedCount; }     //ring was full
+    std::uint64_t stale() const { return staleCount; }         //skipped for a newer scan
+    std::uint64_t malformed() const { return malformedCount; }
+
+private:
+    struct PacketSlot {
+        std::vector<char> data;
+        size_t size = 0;
+    };
+
+    void receiveLoop();
+    bool receiveUdp(PacketSlot& slot);
+    bool receiveTcp(PacketSlot& slot);
+    int readExact(char* buffer, size_t size);
+
+    IngestConfig config;
+    std::vector<PacketSlot> slots;
+    std::atomic<size_t> head{0};    //next slot the receiver fills, only the receiver writes it
+    std::atomic<size_t> tail{0};    //next slot the consumer reads, only the consumer writes it
+
+    std::intptr_t listenSocket = -1;
+    std::intptr_t clientSocket = -1;    //TCP only
+    std::thread thread;
+    std::atomic<bool> running{false};
+
+    std::atomic<std::uint64_t> receivedCount{0};
+    std::atomic<std::uint64_t> droppedCount{0};
+    std::atomic<std::uint64_t> staleCount{0};
+    std::atomic<std::uint64_t> malformedCount{0};
+};
+
+//sending side, used by the loopback test sender
+class NetSender {
+public:
+    NetSender() = default;
+    ~NetSender();
+
+    bool open(IngestProtocol protocol, const std::string& host, unsigned short port);
+    bool send(const std::vector<char>& packet);
+    void close();
+
+private:
+    IngestProtocol protocol = IngestProtocol::Udp;
+    std::intptr_t socketHandle = -1;
+};
+
+#endif
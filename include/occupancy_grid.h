@@ -0,0 +1,87 @@
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "lidar_types.h"
+#include "scan_match.h"
+
+/*
+- Occupancy grid map built up over many frames
+- Cells hold log-odds in hundredths as int16: 0 is unknown, positive occupied, negative free.
+- The map is split into square tiles that are created the first time a beam reaches them,
+- so it grows in any direction and a frame only touches the tiles its beams cross.
+*/
+const int tileShift = 6;
+const int tileSize = 1 << tileShift;            //cells per tile side
+const int tileCells = tileSize * tileSize;
+
+struct OccupancyConfig {
+    double resolution = 0.05;   //metres per cell
+    double hit = 0.85;          //log-odds added where a beam ended
+    double miss = -0.4;         //log-odds added to the cells a beam passed through
+    double minLogOdds = -2.0;   //clamped, so a cell can change its mind after the world changes
+    double maxLogOdds = 3.5;
+};
+
+struct TileKey {
+    int tx, ty;
+};
+
+struct OccupancyTile {
+    TileKey key;
+    std::int16_t logOdds[tileCells];
+    std::uint8_t updated[tileCells / 8];    //cells already changed by the current frame, one bit each
+    bool inFrame = false;                   //changed by the current frame, its bits are cleared at the end
+    bool dirty = false;                     //changed since the last takeDirtyTiles()
+};
+
+class OccupancyGrid {
+public:
+    explicit OccupancyGrid(const OccupancyConfig& config = OccupancyConfig());
+
+    //points in the sensor frame, pose is the sensor in the map; every beam is cast from the sensor
+    void integrate(const Pose2D& pose, const Point2D* points, size_t count);
+
+    //log-odds at a world position, 0 if that part of the map was never seen
+    double logOdds(double x, double y) const;
+    const OccupancyTile* tile(TileKey key) const;
+    size_t tileCount() const { return tiles.size(); }
+    //tiles the last integrate() changed
+    const std::vector<TileKey>& frameTiles() const { return touched; }
+    //tiles changed since the previous call, for exporting only what is new
+    std::vector<TileKey> takeDirtyTiles();
+    //smallest and largest tile coordinates, false if the map is empty
+    bool tileBounds(TileKey& min, TileKey& max) const;
+    const OccupancyConfig& settings() const { return config; }
+
+private:
+    OccupancyTile* tileFor(int tx, int ty);
+    void updateCell(int cx, int cy, std::int16_t delta);
+
+    OccupancyConfig config;
+    std::int16_t hitDelta, missDelta, minValue, maxValue;
+    std::unordered_map<std::uint64_t, std::unique_ptr<OccupancyTile>> tiles;
+    std::vector<TileKey> touched;
+    std::vector<TileKey> dirty;
+
+    //consecutive cells of a ray almost always share a tile
+    OccupancyTile* cachedTile = nullptr;
+    int cachedTx = 0, cachedTy = 0;
+
+    //fixed point step and step count of every ray, reused between frames
+    std::vector<int> stepX, stepY, steps;
+};
+
+//one tile as an 8 bit PGM: black occupied, white free, grey unknown
+bool writeTilePgm(const OccupancyTile& tile, const std::string& filename);
+//the whole map in one PGM, north up
+bool writeMapPgm(const OccupancyGrid& grid, const std::string& filename);
+//writes tile_<tx>_<ty>.pgm for every tile changed since the last export, returns how many
+int exportDirtyTiles(OccupancyGrid& grid, const std::string& directory);
+
+#endif
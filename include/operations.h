@@ -4,15 +4,17 @@
 #include <vector>
 #include <cmath>
 #include <random>
+#include <atomic>
 
-#include "file_read.h"
-#include "constants.h"
+#include "lidar_types.h"
 
 
 double distanceToOrigin(const Point2D& p);
 double distancePointToLine(const Point2D& p, const Line& line);
 
 std::vector<Point2D> convertToCarterisan(const std::vector<double>& ranges, const Scan& params);
+size_t convertToCarterisan(const double* ranges, size_t count, const Scan& params, Point2D* points);
+size_t convertToCarterisan(const float* ranges, size_t count, const Scan& params, Point2D* points);
 Line createLineFromPoints(const Point2D& point1, const Point2D& point2);
 bool computeLineIntersection (const Line& line1, const Line& line2, Point2D& result);
 double computeAngleBetweenLines(const Line& line1, const Line& line2);
@@ -28,9 +30,28 @@ Line findBestLineRANSAC(const std::vector<Point2D>& points,
                         std::vector<int>& bestInliers,
                         const RANSACparameters& config,
                         std::mt19937& gen);
+Line findBestLineRANSAC(const std::vector<Point2D>& points,
+                        const std::vector<int>& availableIndices,
+                        std::vector<int>& bestInliers,
+                        const RANSACparameters& config,
+                        std::mt19937& gen,
+                        Deadline deadline, RANSACstats& stats,
+                        const std::atomic<bool>* cancel = nullptr);
                         
 std::vector<Line> detectLines(const std::vector<Point2D>& points, 
                               const RANSACparameters& config);
+std::vector<Line> detectLines(const std::vector<Point2D>& points, 
+                              const RANSACparameters& config,
+                              Deadline deadline, RANSACstats& stats,
+                              const std::atomic<bool>* cancel = nullptr);
+//same, into lines; the vector and each line's point indices keep their memory from the last call
+void detectLines(const std::vector<Point2D>& points,
+                 const RANSACparameters& config,
+                 Deadline deadline, RANSACstats& stats,
+                 std::vector<Line>& lines,
+                 const std::atomic<bool>* cancel = nullptr);
 std::vector<Intersection> findValidIntersections(const std::vector<Line>& lines, 
                         const std::vector<Point2D>& points, double minAngleThreshold);
+void findValidIntersections(const std::vector<Line>& lines, const std::vector<Point2D>& points,
+                            double minAngleThreshold, std::vector<Intersection>& intersections);
 #endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+#include "lidar_types.h"
+#include "lidar_api.h"
+#include "operations.h"
+#include "triple_buffer.h"
+#include "quadtree.h"
+#include "quantized.h"
+#include "scan_match.h"
+#include "landmark_map.h"
+
+//one scan as it comes from the sensor or a file, before any processing
+struct RawFrame {
+    Header header;
+    Scan scan;
+    std::vector<double> ranges;
+    std::vector<double> intensities;
+};
+
+//everything the renderer needs to show one processed scan
+struct FrameResult {
+    Header header;
+    Scan scan;
+    std::vector<Point2D> points;
+    QuadTree tree;                      //spatial index over points, for culling while drawing
+    QuadTree lineTree;                  //same over the points of the lines; both empty unless config.buildTrees
+    std::vector<Line> lines;
+    std::vector<Intersection> intersections;
+    RANSACstats stats;
+    IcpResult motion;                   //scan match against the previous frame, only filled by ProcessingWorker
+    Pose2D pose;                        //odometry, the sensor's pose relative to the first frame
+    std::vector<int> landmarkIds;       //corner in the landmark map each intersection was merged into
+    size_t landmarkCount = 0;           //corners known after this frame
+    PipelineConfig config;              //settings the lines and intersections were found with
+    unsigned long sequence = 0; //0 means no frame has been processed yet
+};
+
+//fills the frame and returns true when a new one is available, false if there is nothing new yet
+typedef std::function<bool(RawFrame&)> FrameSource;
+//same for sources that already hand out cartesian points, e.g. the network ingest; may block briefly
+typedef std::function<bool(Header&, Scan&, std::vector<Point2D>&)> PointSource;
+
+bool readFrame(const std::string& filename, RawFrame& frame);
+FrameSource watchTomlFile(const std::string& filename);
+void processFrame(const RawFrame& raw, const PipelineConfig& config, FrameResult& result);
+void processPoints(const PipelineConfig& config, FrameResult& result);
+void processQuantizedFrame(const QuantizedFrame& frame, const PipelineConfig& config, FrameResult& result);
+//both quadtrees of a frame whose lines are final, or empty ones when the config does not ask for them
+void buildDisplayTrees(const PipelineConfig& config, FrameResult& result);
+
+//true if both would find the same lines in a frame
+bool sameDetectionSettings(const PipelineConfig& a, const PipelineConfig& b);
+//true if both would give the same lines and intersections
+bool sameSettings(const PipelineConfig& a, const PipelineConfig& b);
+
+//runs the frame source and processing on its own thread, results are handed over lock-free
+class ProcessingWorker {
+public:
+    ProcessingWorker(FrameSource source, const PipelineConfig& config);
+    ProcessingWorker(PointSource pointSource, const PipelineConfig& config);
+    ~ProcessingWorker();
+
+    void start();
+    void stop();
+    //settings for the frames that start after this call
+    void setConfig(const PipelineConfig& config);
+
+    //never blocks; returns true if a newer frame arrived since the last call
+    bool update();
+    //latest complete frame the consumer has taken, valid until the next update()
+    const FrameResult& latest() const;
+    //the same frame, for consumers that swap it out instead of copying it
+    FrameResult& latest();
+
+private:
+    void run();
+    //odometry and landmarks, for frames that went through detection
+    void track(FrameResult& result);
+
+    FrameSource source;
+    PointSource pointSource;    //used instead of source when set
+    PipelineConfig config;
+    std::mutex configMutex;
+    TripleBuffer<FrameResult> results;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    unsigned long sequence = 0;
+    ScanOdometry odometry;      //consecutive frames are matched at sensor rate, on this thread
+    LandmarkMap landmarks;      //only touched by this thread, frames carry the ids and the count
+};
+
+/*
+- Runs the later stages again on a frame that is already processed, after its settings changed
+- A new request cancels the one in flight: detection stops at its next RANSAC iteration and its
+- result is dropped, so only the newest settings ever reach the screen.
+- The source frame is shared, not copied, so a request costs the UI thread nothing per point.
+*/
+class RetuneWorker {
+public:
+    ~RetuneWorker();
+
+    void start();
+    void stop();
+
+    //redetect = false keeps the lines found last for this frame and only searches for intersections again,
+    //unless they were found with other detection settings than config
+    void request(std::shared_ptr<const FrameResult> frame, const PipelineConfig& config, bool redetect);
+    //drops the pending request and stops the running one
+    void cancel();
+    bool busy() const { return working; }
+
+    //same contract as ProcessingWorker; latest().sequence is the sequence of the frame it was made from
+    bool update();
+    const FrameResult& latest() const;
+
+private:
+    void run();
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<bool> working{false};
+    std::atomic<bool> cancelled{false};     //read by detectLines between iterations
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool pending = false;
+    std::shared_ptr<const FrameResult> pendingFrame;
+    PipelineConfig pendingConfig;
+    bool pendingRedetect = false;
+    unsigned long generation = 0;   //bumped by every request and cancel, a result is only published for its own
+
+    //lines of the last detection that ran to the end, only touched by the worker thread
+    std::vector<Line> detectedLines;
+    RANSACstats detectedStats;
+    PipelineConfig detectedConfig;
+    unsigned long detectedSequence = 0;
+
+    TripleBuffer<FrameResult> results;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef QUADTREE_H
+#define QUADTREE_H
+#include <vector>
+
+#include "lidar_types.h"
+
+//square region of the tree, its points are indices[first .. first+count)
+struct QuadNode {
+    double minX, minY;  //bottom left corner in world coordinates
+    double size;        //side length of the square
+    int first;          //first slot in QuadTree::indices
+    int count;          //number of points inside, including all children
+    int children[4];    //SW, SE, NW, NE; -1 if that quarter is empty
+    bool leaf;
+};
+
+//point indices ordered so that every node's points are next to each other
+struct QuadTree {
+    std::vector<QuadNode> nodes;    //nodes[0] is the root
+    std::vector<int> indices;
+};
+
+//a whole node drawn as one shaded square instead of its individual points
+struct DensityCell {
+    double minX, minY;
+    double size;
+    int count;
+};
+
+void buildQuadTree(QuadTree& tree, const std::vector<Point2D>& points, int leafSize = 32, int maxDepth = 16);
+//same, over the points the lines were fitted to only
+void buildQuadTree(QuadTree& tree, const std::vector<Point2D>& points, const std::vector<Line>& lines,
+                   int leafSize = 32, int maxDepth = 16);
+void queryQuadTree(const QuadTree& tree, const std::vector<Point2D>& points,
+                   double minX, double minY, double maxX, double maxY, double minCellSize,
+                   std::vector<int>& visiblePoints, std::vector<DensityCell>& cells);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef QUANTIZED_H
+#define QUANTIZED_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "lidar_types.h"
+
+/*
+- Compact frames for long recordings: ranges as 16 bit fixed point, a quarter of the size of doubles
+- range in metres = value * rangeScale, 0 means no return (range_min is always above it)
+- The default scale is one millimetre, frames with range_max above 65 m get a coarser one
+*/
+struct QuantizedFrame {
+    Header header;
+    Scan scan;
+    float rangeScale = 0.001f;
+    float intensityScale = 1.0f;
+    std::vector<std::uint16_t> ranges;
+    std::vector<std::uint16_t> intensities;
+};
+
+void quantizeFrame(const Header& header, const Scan& scan, const std::vector<double>& ranges,
+                   const std::vector<double>& intensities, QuantizedFrame& frame);
+void dequantizeRanges(const QuantizedFrame& frame, std::vector<double>& ranges);
+void dequantizeIntensities(const QuantizedFrame& frame, std::vector<double>& intensities);
+
+//decode and polar to cartesian in one pass, SSE2 where available; same contract as convertToCarterisan
+size_t convertQuantized(const std::uint16_t* ranges, size_t count, float scale, const Scan& params, Point2D* points);
+//plain C++ version, used on targets without SSE2 and to check the SIMD one
+size_t convertQuantizedScalar(const std::uint16_t* ranges, size_t count, float scale, const Scan& params, Point2D* points);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "pipeline.h"
+
+//how a recorded log is played back
+struct ReplayConfig {
+    double speed = 1.0;         //1 = real time, N = N times faster, 0 = as fast as possible
+    bool dropFrames = true;     //skip to the newest due frame instead of falling behind
+};
+
+//how well the pipeline kept up with the log
+struct ReplayReport {
+    int framesTotal = 0;
+    int framesProcessed = 0;
+    int framesDropped = 0;
+    double logSeconds = 0;      //length of the log according to scan_time
+    double wallSeconds = 0;     //how long the replay actually took
+    double achievedFps = 0;     //processed frames per wall-clock second
+    double latencyP50Ms = 0;    //from the frame's due time until its result was ready
+    double latencyP99Ms = 0;
+    double latencyMaxMs = 0;
+};
+
+bool readFrameBlock(const std::string& block, RawFrame& frame);
+std::vector<RawFrame> readScanLog(const std::string& filename);
+//the same log held as 16 bit frames, a quarter of the memory for long recordings; .lda frames are kept as they are
+std::vector<QuantizedFrame> readScanLogQuantized(const std::string& filename);
+std::vector<double> frameArrivalTimes(const std::vector<RawFrame>& frames, double speed);
+std::vector<double> frameArrivalTimes(const std::vector<QuantizedFrame>& frames, double speed);
+ReplayReport replayLog(const std::vector<QuantizedFrame>& frames, const PipelineConfig& config,
+                       const ReplayConfig& replay,
+                       const std::function<void(const FrameResult&)>& onFrame = nullptr);
+void printReplayReport(const ReplayReport& report);
+
+#endif
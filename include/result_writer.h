@@ -0,0 +1,75 @@
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+
+/*
+- Machine readable results, one record per frame, for downstream tools and batch runs
+- Records are formatted straight into one large buffer with std::to_chars and written out only when it
+- is full, so nothing is flushed per line and no locale or stream state is involved.
+- Ndjson: one JSON object per line with the frame's stats, pose, lines and intersections
+- Csv: "frame", "line" and "intersection" rows, told apart by the record column; one header row covers all
+-   three, every row has all its columns and leaves the other kinds' empty
+- Binary, little endian:
+-   file: "LDRS", uint32 version
+-   record: uint32 size of the rest, uint64 sequence, uint16 length + bytes: frame_id, stamp,
+-   uint32 points, float64 detection ms, uint32 iterations, uint8 flags (1 partial, 2 odometry valid),
+-   float64 pose x, y, yaw,
+-   uint32 line count, per line float64 a, b, c, uint32 inliers,
+-   uint32 intersection count, per intersection float64 x, y, angle, distance, int32 line1, line2, landmark
+*/
+enum class ResultFormat {
+    Ndjson,
+    Csv,
+    Binary
+};
+
+const std::uint32_t resultBinaryVersion = 1;
+
+class ResultWriter {
+public:
+    explicit ResultWriter(size_t bufferBytes = 1 << 20);
+    ~ResultWriter();
+
+    bool open(const std::string& filename, ResultFormat format);
+    void write(const FrameResult& frame);
+    //writes what is buffered, false if any write so far failed
+    bool flush();
+    bool close();
+
+    std::uint64_t framesWritten() const { return frames; }
+    std::uint64_t bytesWritten() const { return written + used; }
+
+private:
+    char* reserve(size_t bytes);
+    void putText(const char* text, size_t length);
+    void putText(const char* text);
+    void putNumber(double value);
+    void putNumber(long long value);
+    void putJsonString(const std::string& text);
+    void putCsvString(const std::string& text);
+    template <typename T> void putRaw(T value);
+    void putShortString(const std::string& text);
+
+    void writeNdjson(const FrameResult& frame);
+    void writeCsv(const FrameResult& frame);
+    void writeBinary(const FrameResult& frame);
+
+    std::FILE* file = nullptr;
+    ResultFormat format = ResultFormat::Ndjson;
+    std::vector<char> buffer;
+    size_t used = 0;
+    std::uint64_t written = 0;
+    std::uint64_t frames = 0;
+    bool failed = false;
+};
+
+//picks the format from the file extension: .csv, .bin, anything else is NDJSON
+ResultFormat resultFormatFor(const std::string& filename);
+
+#endif
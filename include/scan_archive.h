@@ -0,0 +1,67 @@
+#ifndef SCAN_ARCHIVE_H
+#define SCAN_ARCHIVE_H
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "quantized.h"
+
+/*
+- Compressed scan archive (.lda) for long recordings, little endian
+-   file header:  "LDRA" magic, uint32 version
+-   frame record: uint32 payload size, then the payload (see encodeFrame in scan_archive.cpp)
+-   index:        "LDRI" magic, uint32 keyframe interval, uint64 frame count, uint64 offset per frame
+-                 (top bit set on keyframes)
+-   footer:       uint64 index offset, "LDRE" magic
+- Ranges are QuantizedFrame millimetres, stored as zigzag varint deltas: keyframes against the
+- previous beam, other frames against the same beam of the previous frame or the previous beam,
+- whichever is smaller. Random access decodes from the nearest keyframe.
+*/
+class ArchiveWriter {
+public:
+    ~ArchiveWriter();
+
+    bool open(const std::string& filename, int keyframeInterval = 30);
+    bool write(const QuantizedFrame& frame);
+    //writes the index and footer, the archive cannot be read without them
+    bool close();
+
+    std::uint64_t bytesWritten() const { return offset; }
+
+private:
+    std::ofstream file;
+    int keyframeInterval = 30;
+    std::uint64_t offset = 0;
+    std::vector<std::uint64_t> index;
+    QuantizedFrame previous;
+    std::vector<std::uint8_t> payload;
+};
+
+class ArchiveReader {
+public:
+    bool open(const std::string& filename);
+    size_t frameCount() const { return index.size(); }
+    bool isKeyframe(size_t frame) const;
+
+    //any frame in any order, decoding starts at the closest keyframe (or continues if that is closer)
+    bool read(size_t frame, QuantizedFrame& out);
+    //the frame after the last one read
+    bool next(QuantizedFrame& out);
+
+private:
+    bool decodeAt(size_t frame);
+
+    std::ifstream file;
+    std::uint64_t fileSize = 0;         //sizes read from the file are checked against this before allocating
+    std::vector<std::uint64_t> index;
+    std::vector<std::uint8_t> payload;
+    std::uint64_t position = ~0ULL;     //where the stream is, ~0 when unknown
+    QuantizedFrame current;             //last decoded frame, the reference for the next delta frame
+    long long currentFrame = -1;
+};
+
+std::vector<QuantizedFrame> readScanArchive(const std::string& filename);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SCAN_MATCH_H
+#define SCAN_MATCH_H
+#include <vector>
+
+#include "lidar_types.h"
+
+/*
+- Scan-to-scan matching for odometry: point-to-line ICP
+- Every reference point gets a line to be matched against: the detected Line it belongs to, or the line
+- through its neighbouring beams. Each iteration pairs the moved scan with the nearest reference points
+- through a uniform grid, then takes one Gauss-Newton step on the (x, y, yaw) of the scan.
+*/
+
+//rigid motion in the plane: p' = R(yaw) p + (x, y)
+struct Pose2D {
+    double x = 0, y = 0;
+    double yaw = 0;     //radians
+};
+
+struct IcpConfig {
+    int maxIterations = 15;             //fixed budget per match, the match stops here even if still moving
+    double maxCorrespondence = 0.3;     //metres, points with no reference point this close are left out
+    double maxNeighbourGap = 0.2;       //a point further than this from its beam neighbours gets no line
+    double convergeTranslation = 1e-4;  //metres, stop when a step moves less than this...
+    double convergeRotation = 1e-5;     //...and turns less than this (radians)
+    int minCorrespondences = 20;        //fewer pairs than this and the match is not trusted
+};
+
+struct IcpResult {
+    Pose2D pose;                //the scan's pose in the reference scan's frame
+    bool valid = false;         //enough pairs and a solvable system
+    bool converged = false;     //stopped before the iteration budget ran out
+    int iterations = 0;
+    int correspondences = 0;    //pairs used in the last iteration
+    double rms = 0;             //metres, point-to-line error of those pairs
+    double elapsedMs = 0;
+};
+
+//reference points bucketed by cell, cell (cx, cy) holds indices[cellStart[c] .. cellStart[c+1])
+struct PointGrid {
+    double minX = 0, minY = 0;
+    double cellSize = 1;
+    int width = 0, height = 0;
+    std::vector<int> cellStart;
+    std::vector<int> indices;
+};
+
+//a reference scan prepared for matching, reused for every scan matched against it
+struct IcpReference {
+    std::vector<Point2D> points;
+    std::vector<double> nx, ny, d;      //unit normal and offset of each point's line, nx = ny = 0 if it has none
+    PointGrid grid;                     //only points that have a line
+};
+
+void buildPointGrid(PointGrid& grid, const std::vector<Point2D>& points, const std::vector<int>& indices, double cellSize);
+void prepareReference(const std::vector<Point2D>& points, const std::vector<Line>& lines, const IcpConfig& config,
+                      IcpReference& reference);
+IcpResult matchScans(const IcpReference& reference, const std::vector<Point2D>& points, const Pose2D& initial,
+                     const IcpConfig& config);
+
+Pose2D composePose(const Pose2D& a, const Pose2D& b);
+
+//chains scan-to-scan matches into a pose; each scan becomes the reference for the next one
+class ScanOdometry {
+public:
+    explicit ScanOdometry(const IcpConfig& config = IcpConfig()) : config(config) {}
+
+    //the first scan only becomes the reference, its result is valid with an identity pose
+    IcpResult addScan(const std::vector<Point2D>& points, const std::vector<Line>& lines);
+    const Pose2D& pose() const { return current; }
+    void reset();
+
+private:
+    IcpConfig config;
+    IcpReference reference;
+    bool hasReference = false;
+    Pose2D current;
+    Pose2D lastMotion;  //the next match starts from the same motion again
+};
+
+#endif
@@ -6,22 +6,133 @@
 
 #include "operations.h"
 #include "constants.h"
+#include "quadtree.h"
+#include "lidar_api.h"
+
+//which part of the world the graph frame shows, changed by panning and zooming
+struct Viewport {
+    float scale = gridscale;    //pixels per meter
+    double centerX = 0;         //world point shown in the middle of the frame
+    double centerY = 0;
+
+    //mouse drag in progress, last mouse position in screen coordinates
+    bool dragging = false;
+    float dragX = 0, dragY = 0;
+};
+
+//geometry collected during a frame, every layer is drawn with a single call
+struct RenderBatch {
+    sf::VertexArray cells{sf::PrimitiveType::Triangles};    //aggregated density cells when zoomed out
+    sf::VertexArray dots{sf::PrimitiveType::Triangles};     //raw and in-line points, textured circles
+    sf::VertexArray lines{sf::PrimitiveType::Triangles};    //detected lines and dashed robot rays
+    sf::VertexArray markers{sf::PrimitiveType::Triangles};  //intersection marks, drawn on top
+};
+
+//grid and axis labels, rendered once per view and reused every frame
+struct StaticLayer {
+    sf::RenderTexture texture;
+    bool ready = false;
+    unsigned long viewVersion = 0;  //view the grid was drawn for
+};
+
+//legend and labels laid out for one result, reused until the result changes
+struct LabelCache {
+    sf::RenderTexture legend;               //legend panel, drawn with one sprite
+    bool legendReady = false;
+    std::vector<sf::Text> lineLabels;       //"L1", "L2"... next to each line
+    std::vector<sf::Text> intersectionLabels; //angle and distance next to each intersection
+    unsigned long version = 0;              //result version the cache was built for, 0 = never built
+    unsigned long viewVersion = 0;          //labels sit at screen positions, so they follow the view too
+};
+
+//decides when the window actually has to be painted again
+struct RedrawPolicy {
+    bool dirty = true;          //data, view or window changed since the last paint
+    unsigned frameLimit = 60;   //upper bound on paints per second, 0 means no cap
+    float statsInterval = 1.f;  //seconds between refreshes of the stats overlay
+};
+
+//paint cost and process CPU load, shown in the corner of the window
+struct FrameStats {
+    float lastFrameMs = 0;      //time spent building and submitting the last paint
+    float avgFrameMs = 0;       //average over the last stats interval
+    float cpuPercent = 0;       //process CPU time over wall time, for the last interval
+    int paintsPerInterval = 0;  //how many paints happened in the last interval
+
+    //bookkeeping for the current interval
+    sf::Clock intervalClock;
+    double intervalCpuStart = -1;
+    float intervalFrameMs = 0;
+    int intervalPaints = 0;
+};
+
+//which stages a settings change makes stale
+enum class StaleStages {
+    None,
+    Intersections,  //only the angle threshold changed, the lines still stand
+    Detection       //a RANSAC setting changed, lines and intersections both have to be found again
+};
+
+//settings changed live from the keyboard: Tab picks one, [ and ] change it, R restores the start values
+struct TuningState {
+    PipelineConfig config;
+    PipelineConfig initial;
+    int selected = 0;           //0 minPoints, 1 distanceThreshold, 2 maxIterations, 3 minAngleThreshold
+    bool busy = false;          //a recompute is running in the background
+};
 
 int draw();
-void robot(sf::RenderWindow& window, sf::Font& font);
+void robot(sf::RenderTarget& window, sf::Font& font, const Viewport& view);
 void dots(sf::RenderWindow& window, sf::Font& font, std::vector<double> dotsPosArr);
-void screen(sf::RenderWindow& window, float scale, sf::Font font, float startX, float startY, float endX, float endY);
-void mainFrame(sf::RenderWindow& window, sf::Font& font, float sizeX, float sizeY, float posX, float posY, int thickness);
-int addLine (sf::RenderWindow& window, float sizeX, float sizeY, float posX, float posY, sf::Color color, float angle, bool centerContent);
+void screen(sf::RenderTarget& window, const Viewport& view, float startX, float startY, float endX, float endY);
+void mainFrame(sf::RenderTarget& window, sf::Font& font, const Viewport& view, float sizeX, float sizeY, float posX, float posY, int thickness);
+int addLine (sf::RenderTarget& window, float sizeX, float sizeY, float posX, float posY, sf::Color color, float angle, bool centerContent);
 float convertCoordinateX(float x, float scale);
 float convertCoordinateY(float y, float scale);
-int addText (sf::RenderWindow& window, sf::Font& font, std::string message, float size, sf::Color color, bool textAlign, float posX, float posY, bool setRotate);
-int addDot (sf::RenderWindow& window, float size, bool dotAlign, float posX, float posY, sf::Color color);
-void drawInRangeDots(sf::RenderWindow& window, sf::Font& font, Point2D& point, int precision, sf::Color color);
-void drawIntersectionMarker(sf::RenderWindow& window, sf::Font& font, const Intersection& intersection, bool showLabel = true);
-void drawDetectedLine(sf::RenderWindow& window, const std::vector<Point2D>& points, const Line& line, sf::Color color);
-void drawLegend(sf::RenderWindow& window, sf::Font& font, int numLines, int numIntersections, std::vector<Line>& detectedLines, std::vector<Point2D>& allDots, std::vector<Intersection>& validIntersections);
-void drawDashedLineBetweenPoints(sf::RenderWindow& window, const Point2D& p1, const Point2D& p2,
-                                 sf::Color color, float thickness = 2.0f, float dashLength = 10.0f);
+float convertCoordinateX(double x, const Viewport& view);
+float convertCoordinateY(double y, const Viewport& view);
+Point2D screenToWorld(float screenX, float screenY, const Viewport& view);
+void zoomViewport(Viewport& view, float factor, float screenX, float screenY);
+void panViewport(Viewport& view, float dx, float dy);
+void visibleWorldRect(const Viewport& view, double& minX, double& minY, double& maxX, double& maxY);
+double gridStep(const Viewport& view);
+std::string formatAxisValue(double value, double step);
+bool handleViewportEvent(Viewport& view, const sf::Event& event, const sf::RenderWindow& window);
+sf::Text makeText (sf::Font& font, std::string message, float size, sf::Color color, bool textAlign, float posX, float posY, bool setRotate);
+int addText (sf::RenderTarget& window, sf::Font& font, std::string message, float size, sf::Color color, bool textAlign, float posX, float posY, bool setRotate);
+int addDot (sf::RenderTarget& window, float size, bool dotAlign, float posX, float posY, sf::Color color);
+
+void clearBatch(RenderBatch& batch);
+void batchDot(sf::VertexArray& batch, float size, float posX, float posY, sf::Color color);
+void batchLine(sf::VertexArray& batch, float sizeX, float sizeY, float posX, float posY, sf::Color color, float angle);
+void drawBatch(sf::RenderTarget& target, const RenderBatch& batch);
+bool buildStaticLayer(StaticLayer& layer, sf::Font& font, const Viewport& view);
+void drawStaticLayer(sf::RenderTarget& target, const StaticLayer& layer);
+void drawBatchInFrame(sf::RenderTarget& target, const RenderBatch& batch);
+
+bool eventNeedsRedraw(const sf::Event& event);
+double processCpuSeconds();
+void recordFrame(FrameStats& stats, float frameMs);
+bool updateFrameStats(FrameStats& stats, const RedrawPolicy& policy);
+void drawFrameStats(sf::RenderTarget& target, sf::Font& font, const FrameStats& stats);
+StaleStages handleTuningEvent(TuningState& state, const sf::Event& event);
+void drawTuningHud(sf::RenderTarget& target, sf::Font& font, const TuningState& state, const RANSACstats& stats);
+
+void drawInRangeDots(RenderBatch& batch, const Point2D& point, sf::Color color, const Viewport& view);
+void drawDensityCell(RenderBatch& batch, const DensityCell& cell, sf::Color color, const Viewport& view);
+void drawIntersectionMarker(RenderBatch& batch, const Intersection& intersection, const Viewport& view);
+sf::Text makeIntersectionLabel(sf::Font& font, const Intersection& intersection, const Viewport& view);
+sf::Text makeLineLabel(sf::Font& boldFont, const std::vector<Point2D>& points, const Line& line, int lineNumber, const Viewport& view);
+void drawDetectedLine(RenderBatch& batch, const std::vector<Point2D>& points, const Line& line, sf::Color color, const Viewport& view);
+void drawLegend(sf::RenderTarget& window, sf::Font& font, int numLines, int numIntersections, const std::vector<Line>& detectedLines, const std::vector<Point2D>& allDots, const std::vector<Intersection>& validIntersections);
+bool updateLabelCache(LabelCache& cache, sf::Font& font, sf::Font& boldFont,
+                      const std::vector<Point2D>& points, const std::vector<Line>& lines,
+                      const std::vector<Intersection>& intersections, unsigned long version,
+                      const Viewport& view, unsigned long viewVersion);
+void drawLabelCache(sf::RenderTarget& target, const LabelCache& cache);
+void drawLineBetweenPoints(RenderBatch& batch, const Point2D& p1, const Point2D& p2,
+                           sf::Color color, const Viewport& view, float thickness = 2.0f);
+void drawDashedLineBetweenPoints(RenderBatch& batch, const Point2D& p1, const Point2D& p2,
+                                 sf::Color color, const Viewport& view, float thickness = 2.0f, float dashLength = 10.0f);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "lidar_types.h"
+
+/*
+- Shared memory frame ring for a lidar driver running on the same machine
+- Layout: ShmRingHeader, then slotCount slots of slotBytes each (ShmSlot followed by maxBeams float32 ranges)
+- Every slot is a seqlock: seq is odd while the driver writes it and even once the frame is complete;
+- a reader checks seq before and after reading and throws the read away if it changed
+- Neither side makes a syscall per frame, the reader converts the ranges where the driver left them
+*/
+const std::uint32_t shmRingMagic = 0x4D52444C; //"LDRM"
+const std::uint32_t shmRingVersion = 1;
+
+struct ShmRingHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t slotCount;
+    std::uint32_t maxBeams;
+    std::uint64_t slotBytes;
+    std::atomic<std::uint64_t> published;  //frames committed so far, the newest is published - 1
+};
+
+struct ShmSlot {
+    std::atomic<std::uint64_t> seq;
+    std::uint64_t frameNumber;
+    std::int64_t writeTimeNs;   //steady clock when the frame was committed, for latency measurement
+    std::uint32_t rangeCount;
+    std::uint32_t reserved;
+    char stamp[32];
+    char frameId[32];
+    double angle_min;
+    double angle_max;
+    double angle_increment;
+    double time_increment;
+    double scan_time;
+    double range_min;
+    double range_max;
+};
+
+const char shmDefaultName[] = "lidar_scans";
+
+std::int64_t steadyNowNs();
+
+//driver side: creates the ring and publishes frames into it
+class ShmRingWriter {
+public:
+    ShmRingWriter() = default;
+    ~ShmRingWriter();
+
+    bool create(const std::string& name, size_t slotCount = 16, size_t maxBeams = 16384);
+    void close();
+
+    //hands out the range array of the next slot to fill in place, nullptr if rangeCount is too large
+    float* beginFrame(const Header& header, const Scan& scan, size_t rangeCount);
+    void commitFrame();
+    //copying version for drivers that already have the ranges in their own buffer
+    bool writeFrame(const Header& header, const Scan& scan, const std::vector<double>& ranges);
+
+private:
+    std::string name;
+    void* base = nullptr;
+    size_t size = 0;
+    std::intptr_t handle = -1;
+    ShmSlot* current = nullptr;
+    std::uint64_t frameNumber = 0;
+};
+
+//pipeline side: attaches to an existing ring and reads the newest frame in place
+class ShmRingReader {
+public:
+    ShmRingReader() = default;
+    ~ShmRingReader();
+
+    bool open(const std::string& name);
+    void close();
+
+    //converts the newest unseen frame into points, false if none was committed in time
+    bool readLatest(Header& header, Scan& scan, std::vector<Point2D>& points, int timeoutMs = 20);
+
+    std::uint64_t framesRead() const { return readCount; }
+    std::uint64_t framesSkipped() const { return skippedCount; } //committed but never read, a newer one came first
+    std::uint64_t tornReads() const { return tornCount; }        //overwritten while reading, retried
+    double lastLatencyMs() const { return latencyMs; }           //commit to points ready, for the last frame
+
+private:
+    void* base = nullptr;
+    size_t size = 0;
+    std::intptr_t handle = -1;
+    std::uint64_t nextFrame = 0;
+    std::uint64_t readCount = 0;
+    std::uint64_t skippedCount = 0;
+    std::uint64_t tornCount = 0;
+    double latencyMs = 0;
+};
+
+#endif
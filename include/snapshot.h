@@ -0,0 +1,42 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+
+/*
+- Software rasterizer for machines without a display or GPU
+- Draws the graph frame of the window (grid, raw points, detected lines with their points,
+- intersection markers and the robot) with the same colours and sizes into an RGB image, and saves it
+- as PNG or PPM. Text is left out, there is no font renderer. Nothing here touches SFML, so it is
+- safe to call from any number of threads at once, each with its own image.
+*/
+enum class ImageFormat {
+    Png,
+    Ppm
+};
+
+//RGB, 3 bytes per pixel, rows from the top
+struct Image {
+    int width = 0, height = 0;
+    std::vector<std::uint8_t> pixels;
+};
+
+//same mapping as Viewport: centerX/Y lands in the middle of the image
+struct SnapshotView {
+    int width = 600, height = 600;  //the window's graph frame
+    double scale = 100.0;           //pixels per metre
+    double centerX = 0, centerY = 0;
+};
+
+void renderSnapshot(const FrameResult& frame, const SnapshotView& view, Image& image);
+
+//encoders append to out, so a caller can reuse one buffer for every frame
+void encodePpm(const Image& image, std::vector<std::uint8_t>& out);
+//fixed Huffman deflate with pixel and row repeats as the only matches, the scene is mostly flat colour
+void encodePng(const Image& image, std::vector<std::uint8_t>& out);
+bool writeImage(const Image& image, ImageFormat format, const std::string& filename);
+
+#endif
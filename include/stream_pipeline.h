@@ -0,0 +1,51 @@
+#ifndef STREAM_PIPELINE_H
+#define STREAM_PIPELINE_H
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "pipeline.h"
+
+/*
+- Staged version of processFrame for streams of many frames:
+-   parse -> convert -> detect -> intersect -> output
+- Every stage runs on its own worker thread(s), stages are joined by bounded lock-free queues.
+- A full queue makes the stage before it wait, so a slow stage holds everything upstream back
+- instead of piling up frames. Frames live in a fixed pool, nothing is allocated per frame.
+*/
+struct StreamConfig {
+    size_t queueCapacity = 8;   //frames that can wait between two stages
+    int parseWorkers = 1;
+    int convertWorkers = 1;
+    int detectWorkers = 2;
+    int intersectWorkers = 1;
+    bool inOrder = true;        //hand results to the output in log order, otherwise as they finish
+};
+
+//what one stage did during a run, to find the stage that limits throughput
+struct StageStats {
+    std::string name;
+    int workers = 0;
+    unsigned long items = 0;
+    double busySeconds = 0;     //doing work, summed over the workers
+    double blockedSeconds = 0;  //waiting for room in the next queue
+    double utilization = 0;     //busy / (workers * wall time), near 1 means this stage is the bottleneck
+    double queueDepthAvg = 0;   //frames waiting in the input queue, sampled on every take
+    size_t queueDepthMax = 0;
+    size_t queueCapacity = 0;
+};
+
+struct StreamReport {
+    int frames = 0;
+    int failed = 0;             //blocks that did not parse
+    double wallSeconds = 0;
+    double fps = 0;
+    std::vector<StageStats> stages;
+};
+
+StreamReport runStreamPipeline(const std::vector<std::string>& blocks, const PipelineConfig& config,
+                               const StreamConfig& stream,
+                               const std::function<void(const FrameResult&)>& onResult = nullptr);
+void printStreamReport(const StreamReport& report);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+#include <string>
+#include <vector>
+
+#include "lidar_types.h"
+#include "pipeline.h"
+
+/*
+- Synthetic scans with known answers, for regression and benchmark runs
+- A scene is a set of wall segments around the robot at the origin; scans are made by casting
+- one ray per beam against the walls and adding gaussian range noise.
+*/
+struct SyntheticWall {
+    Point2D a, b;
+};
+
+struct SyntheticScene {
+    std::string shape;
+    std::vector<SyntheticWall> walls;
+};
+
+//what a perfect detector would report for one synthetic scan
+struct GroundTruth {
+    std::vector<int> wallHits;      //beams that landed on each wall
+    int lines = 0;                  //walls hit by at least minPoints beams
+};
+
+//270 degree sensor, half degree steps, 8 m range
+Scan syntheticScan();
+//shape is room, lshape, corridor or clutter; the seed picks size, placement and rotation
+bool makeScene(const std::string& shape, unsigned seed, SyntheticScene& scene);
+//the scene as a robot standing at (x, y) and facing yaw sees it, for scans along a path
+SyntheticScene sceneFromPose(const SyntheticScene& scene, double x, double y, double yaw);
+RawFrame renderScene(const SyntheticScene& scene, const Scan& scan, double noise, unsigned seed,
+                     int minPoints, GroundTruth& truth);
+//the scan as log text, the same format readFrameBlock reads
+std::string formatScanToml(const RawFrame& frame);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+#include <atomic>
+#include <cstdint>
+
+/*
+- Lock-free single producer / single consumer handoff of the latest value
+- The producer always has a buffer to write into, the consumer always has a buffer to read from,
+- and the third one sits in the middle holding the newest complete value.
+- Neither side ever waits for the other; the consumer simply skips values it was too slow to see.
+*/
+template <typename T>
+class TripleBuffer {
+public:
+    //buffer the producer fills, only valid until the next publish()
+    T& writeBuffer() { return buffers[writeIndex]; }
+
+    //hand the written buffer to the consumer and take the middle one to write next
+    void publish() {
+        std::uint8_t previous = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel);
+        writeIndex = previous & indexMask;
+    }
+
+    //take the newest published buffer if there is one, returns false if nothing new came
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & freshBit)) return false;
+        std::uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & indexMask;
+        return true;
+    }
+
+    //buffer the consumer reads, stays the same until the next update()
+    const T& readBuffer() const { return buffers[readIndex]; }
+    //the consumer may also move the value out; the producer overwrites whatever it finds in the buffer
+    T& readBuffer() { return buffers[readIndex]; }
+
+private:
+    static constexpr std::uint8_t indexMask = 0x3;
+    static constexpr std::uint8_t freshBit = 0x4;
+
+    T buffers[3];
+    std::uint8_t writeIndex = 0;        //owned by the producer
+    std::uint8_t readIndex = 2;         //owned by the consumer
+    std::atomic<std::uint8_t> middle{1}; //shared, index of the middle buffer plus the fresh bit
+};
+
+#endif
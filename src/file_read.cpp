@@ -1,5 +1,6 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <curl/curl.h>
@@ -63,14 +64,18 @@ std::string trim(const std::string& s) {
 //reads the first three lines of codes, that is explicitly start with "[header]"
 Header readHeader(const std::string& filename) {
     std::ifstream file(filename);
-    Header header = {"none", "none"};
 
     //checks if file is there; if its not there, return default header struct
     if (!file.is_open()){
         std::cerr << "File couldn't be found" << std::endl;
-        return header; 
+        return {"none", "none"}; 
     }
+    return readHeader(file);
+}
 
+//same as above, for text that is already in memory or a part of a bigger file
+Header readHeader(std::istream& file) {
+    Header header = {"none", "none"};
     std::string line;
     //finds header, and gets the stamp and frame id
     while (std::getline(file, line)) {
@@ -87,22 +92,24 @@ Header readHeader(const std::string& filename) {
             break;
         }
     }
-    file.close();
     return header;
 }
 
 //using getline
 Scan readScan(const std::string& filename) {
     std::ifstream file(filename);
-    Scan scan = {0, 0, 0, 0, 0, 0, 0}; //default scan struct
 
     //checks if the file is there; if its not there, function returns default scan struct
     if (!file.is_open()) {
         std::cerr << "File couldn't be found";
         file.close();
-        return scan;
+        return {0, 0, 0, 0, 0, 0, 0};
     }
+    return readScan(file);
+}
 
+Scan readScan(std::istream& file) {
+    Scan scan = {0, 0, 0, 0, 0, 0, 0}; //default scan struct
     std::string line; //temporary line for searching through lines
     bool isScan = false; //if [scan] is seen in the file, this will be true and it will check whats under there
 
@@ -133,7 +140,6 @@ Scan readScan(const std::string& filename) {
             else;
         }
     }
-    file.close();
     return scan;
 }
 
@@ -145,7 +151,10 @@ std::vector<double> readRanges(const std::string& filename) {
         file.close();
         return ERROR_VECTOR;
     }
+    return readRanges(file);
+}
 
+std::vector<double> readRanges(std::istream& file) {
     std::string line;
     std::vector<double> ranges;
     bool in_ranges = false;
@@ -180,7 +189,6 @@ std::vector<double> readRanges(const std::string& filename) {
             if (numStr != "") ranges.push_back(std::stod(numStr)); // end of the ranges datas, the last number does not followed up by comma, that is for that
         }
     }
-    file.close();
     return ranges;
 }
 
@@ -194,7 +202,10 @@ std::vector<double> readIntensities(const std::string& filename) {
         file.close();
         return ERROR_VECTOR;
     }
-    
+    return readIntensities(file);
+}
+
+std::vector<double> readIntensities(std::istream& file) {
     std::string line;
     bool in_intensities = false;
     std::vector<double> intensities;
@@ -228,6 +239,31 @@ std::vector<double> readIntensities(const std::string& filename) {
             if (numStr != "") intensities.push_back(std::stod(numStr)); //check for the last value
         }
     }
-    file.close();
     return intensities;
 }
+
+//splits a log of many scans into the text of each scan, every scan starts with its own "[header]"
+std::vector<std::string> readFrameBlocks(const std::string& filename) {
+    std::ifstream file(filename);
+    std::vector<std::string> blocks;
+    if (!file.is_open()) {
+        std::cerr << "File couldn't be opened" << std::endl;
+        return blocks;
+    }
+
+    std::string line;
+    std::ostringstream block;
+    bool inFrame = false;
+    while (std::getline(file, line)) {
+        //logs written on Windows end their lines in \r\n
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line == HEADER) {
+            if (inFrame) blocks.push_back(block.str());
+            block.str("");
+            inFrame = true;
+        }
+        if (inFrame) block << line << '\n';
+    }
+    if (inFrame) blocks.push_back(block.str());
+    return blocks;
+}
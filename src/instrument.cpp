@@ -0,0 +1,197 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include "instrument.h"
+
+#ifdef LIDAR_INSTRUMENT
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdlib>
+#include <new>
+
+//every thread keeps at most this many trace events, the summary keeps counting past it
+static const size_t maxEventsPerThread = 1 << 20;
+
+struct TraceEvent {
+    const char* name;
+    std::int64_t startNs;
+    std::int64_t durationNs;
+};
+
+//totals per scope name, a handful of names so a linear search is enough
+struct ScopeTotal {
+    const char* name;
+    std::uint64_t count;
+    std::int64_t totalNs;
+    std::int64_t maxNs;
+};
+
+//written only by its own thread, read by the reports after the threads are done
+struct ThreadRecord {
+    int threadId;
+    std::vector<TraceEvent> events;
+    std::vector<ScopeTotal> totals;
+    std::atomic<std::uint64_t> counters[CounterCount];
+};
+
+static std::mutex registryMutex;
+static std::vector<ThreadRecord*> registry; //records are never freed, threads may end before the report
+static std::atomic<std::uint64_t> allocationCount{0};
+
+static std::int64_t nowNs() {
+    static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+static ThreadRecord& threadRecord() {
+    thread_local ThreadRecord* record = nullptr;
+    if (!record) {
+        record = new ThreadRecord();
+        for (auto& counter : record->counters) counter.store(0, std::memory_order_relaxed);
+        record->events.reserve(4096);
+        std::lock_guard<std::mutex> lock(registryMutex);
+        record->threadId = registry.size() + 1;
+        registry.push_back(record);
+    }
+    return *record;
+}
+
+ScopedTimer::ScopedTimer(const char* name) : name(name), startNs(nowNs()) {}
+
+ScopedTimer::~ScopedTimer() {
+    std::int64_t duration = nowNs() - startNs;
+    ThreadRecord& record = threadRecord();
+    if (record.events.size() < maxEventsPerThread) record.events.push_back({name, startNs, duration});
+
+    for (ScopeTotal& total : record.totals) {
+        if (total.name != name) continue;
+        total.count++;
+        total.totalNs += duration;
+        if (duration > total.maxNs) total.maxNs = duration;
+        return;
+    }
+    record.totals.push_back({name, 1, duration, duration});
+}
+
+void instrumentCount(InstrumentCounter counter, std::uint64_t amount) {
+    //only this thread writes its counters, so a plain add is enough
+    std::atomic<std::uint64_t>& value = threadRecord().counters[counter];
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+//every heap allocation in the program goes through here while instrumentation is on
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+static const char* counterNames[CounterCount] = {"iterations", "candidates", "rejected early", "inliers tested", "allocations"};
+
+static void counterTotals(std::uint64_t totals[CounterCount]) {
+    for (int c = 0; c < CounterCount; c++) totals[c] = 0;
+    for (ThreadRecord* record : registry)
+        for (int c = 0; c < CounterCount; c++) totals[c] += record->counters[c].load(std::memory_order_relaxed);
+    totals[CounterAllocations] = allocationCount.load(std::memory_order_relaxed);
+}
+
+void printInstrumentSummary() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    //merge the per thread totals by scope name
+    std::vector<ScopeTotal> totals;
+    for (ThreadRecord* record : registry) {
+        for (const ScopeTotal& t : record->totals) {
+            bool merged = false;
+            for (ScopeTotal& m : totals) {
+                if (std::string(m.name) != t.name) continue;
+                m.count += t.count;
+                m.totalNs += t.totalNs;
+                if (t.maxNs > m.maxNs) m.maxNs = t.maxNs;
+                merged = true;
+                break;
+            }
+            if (!merged) totals.push_back(t);
+        }
+    }
+
+    std::cout << "\n=== Instrumentation ===" << std::endl;
+    std::cout << std::left << std::setw(16) << "scope" << std::right << std::setw(10) << "calls"
+              << std::setw(12) << "total ms" << std::setw(12) << "mean ms" << std::setw(12) << "max ms" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const ScopeTotal& t : totals) {
+        std::cout << std::left << std::setw(16) << t.name << std::right << std::setw(10) << t.count
+                  << std::setw(12) << t.totalNs / 1e6
+                  << std::setw(12) << t.totalNs / 1e6 / t.count
+                  << std::setw(12) << t.maxNs / 1e6 << std::endl;
+    }
+    std::cout << std::defaultfloat;
+
+    std::uint64_t counters[CounterCount];
+    counterTotals(counters);
+    for (int c = 0; c < CounterCount; c++)
+        std::cout << std::left << std::setw(16) << counterNames[c] << std::right << std::setw(10) << counters[c] << std::endl;
+}
+
+//trace event format: one complete ("X") event per scope, counter totals as a "C" event at the end
+bool writeChromeTrace(const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Trace file could not be written: " << filename << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    std::int64_t endNs = 0;
+    bool first = true;
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << std::fixed << std::setprecision(3);
+    for (ThreadRecord* record : registry) {
+        for (const TraceEvent& e : record->events) {
+            file << (first ? "" : ",\n") << "{\"name\":\"" << e.name << "\",\"cat\":\"lidar\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                 << record->threadId << ",\"ts\":" << e.startNs / 1e3 << ",\"dur\":" << e.durationNs / 1e3 << "}";
+            first = false;
+            if (e.startNs + e.durationNs > endNs) endNs = e.startNs + e.durationNs;
+        }
+    }
+
+    std::uint64_t counters[CounterCount];
+    counterTotals(counters);
+    file << (first ? "" : ",\n") << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":" << endNs / 1e3 << ",\"args\":{";
+    for (int c = 0; c < CounterCount; c++)
+        file << (c ? "," : "") << "\"" << counterNames[c] << "\":" << counters[c];
+    file << "}}\n]}\n";
+    return file.good();
+}
+
+#else
+
+void printInstrumentSummary() {
+    std::cout << "Instrumentation is off, build with -DLIDAR_INSTRUMENT to turn it on" << std::endl;
+}
+
+bool writeChromeTrace(const std::string&) {
+    return false;
+}
+
+#endif
+
+void finishInstrumentation(const std::string& traceFile) {
+#ifdef LIDAR_INSTRUMENT
+    printInstrumentSummary();
+    if (writeChromeTrace(traceFile)) std::cout << "Trace written to " << traceFile << std::endl;
+#else
+    (void)traceFile;
+#endif
+}
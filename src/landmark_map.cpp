@@ -0,0 +1,218 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+#include "landmark_map.h"
+
+static std::uint64_t cellHash(long cx, long cy) {
+    return ((std::uint64_t)(std::uint32_t)cx << 32) | (std::uint32_t)cy;
+}
+
+LandmarkMap::LandmarkMap(const LandmarkConfig& config)
+    : config(config), inverseCell(1.0 / config.mergeRadius) {}
+
+std::uint64_t LandmarkMap::cellOf(double x, double y) const {
+    return cellHash((long)std::floor(x * inverseCell), (long)std::floor(y * inverseCell));
+}
+
+void LandmarkMap::insertIntoCell(std::uint64_t cell, int id) {
+    cells[cell].push_back(id);
+}
+
+void LandmarkMap::removeFromCell(std::uint64_t cell, int id) {
+    auto found = cells.find(cell);
+    if (found == cells.end()) return;
+    std::vector<int>& ids = found->second;
+    auto it = std::find(ids.begin(), ids.end(), id);
+    if (it != ids.end()) {
+        *it = ids.back();
+        ids.pop_back();
+    }
+    if (ids.empty()) cells.erase(found);
+}
+
+int LandmarkMap::addObservations(const Pose2D& pose, const std::vector<Intersection>& intersections,
+                                 unsigned long frame, std::vector<int>& ids) {
+    double c = std::cos(pose.yaw), s = std::sin(pose.yaw);
+    size_t before = size();
+
+    ids.resize(intersections.size());
+    for (size_t i = 0; i < intersections.size(); i++) {
+        const Point2D& p = intersections[i].point;
+        Point2D world = {pose.x + c * p.x - s * p.y, pose.y + s * p.x + c * p.y};
+        ids[i] = observe(world, intersections[i].angle_degrees, frame);
+    }
+    int added = (int)(size() - before);
+
+    //a pass over all corners every forgetFrames frames is enough, nothing can expire sooner
+    if (frame >= lastForget + config.forgetFrames) forgetStale(frame);
+    return added;
+}
+
+int LandmarkMap::observe(const Point2D& point, double angle_degrees, unsigned long frame) {
+    //the merge radius is one cell, so the match can only be in the 3x3 cells around the point
+    long cx = (long)std::floor(point.x * inverseCell);
+    long cy = (long)std::floor(point.y * inverseCell);
+    double radius2 = config.mergeRadius * config.mergeRadius;
+    int best = -1;
+    double bestDistance = radius2;
+    for (long y = cy - 1; y <= cy + 1; y++) {
+        for (long x = cx - 1; x <= cx + 1; x++) {
+            auto found = cells.find(cellHash(x, y));
+            if (found == cells.end()) continue;
+            for (int id : found->second) {
+                const Landmark& l = items[id];
+                if (std::fabs(l.angle_degrees - angle_degrees) > config.angleTolerance) continue;
+                double dx = l.point.x - point.x, dy = l.point.y - point.y;
+                double d = dx * dx + dy * dy;
+                if (d <= bestDistance) {
+                    bestDistance = d;
+                    best = id;
+                }
+            }
+        }
+    }
+
+    if (best < 0) {
+        Landmark l = {point, angle_degrees, 1, frame, frame};
+        if (!freeSlots.empty()) {
+            best = freeSlots.back();
+            freeSlots.pop_back();
+            items[best] = l;
+        } else {
+            best = (int)items.size();
+            items.push_back(l);
+        }
+        insertIntoCell(cellOf(point.x, point.y), best);
+        return best;
+    }
+
+    //running average, capped so a corner keeps following small corrections of the odometry
+    Landmark& l = items[best];
+    std::uint64_t oldCell = cellOf(l.point.x, l.point.y);
+    l.observations++;
+    double weight = 1.0 / std::min(l.observations, config.maxWeight);
+    l.point.x += (point.x - l.point.x) * weight;
+    l.point.y += (point.y - l.point.y) * weight;
+    l.angle_degrees += (angle_degrees - l.angle_degrees) * weight;
+    l.lastSeen = frame;
+
+    std::uint64_t newCell = cellOf(l.point.x, l.point.y);
+    if (newCell != oldCell) {
+        removeFromCell(oldCell, best);
+        insertIntoCell(newCell, best);
+    }
+    absorbNeighbours(best);
+    return best;
+}
+
+//corners the updated one now overlaps are the same corner placed with a worse pose, they are folded into it
+void LandmarkMap::absorbNeighbours(int id) {
+    findInRadius(items[id].point.x, items[id].point.y, config.mergeRadius, nearby);
+    for (int other : nearby) {
+        if (other == id) continue;
+        Landmark& l = items[id];
+        const Landmark& o = items[other];
+        if (std::fabs(l.angle_degrees - o.angle_degrees) > config.angleTolerance) continue;
+
+        std::uint64_t oldCell = cellOf(l.point.x, l.point.y);
+        double weight = std::min(l.observations, config.maxWeight);
+        double otherWeight = std::min(o.observations, config.maxWeight);
+        double share = otherWeight / (weight + otherWeight);
+        l.point.x += (o.point.x - l.point.x) * share;
+        l.point.y += (o.point.y - l.point.y) * share;
+        l.angle_degrees += (o.angle_degrees - l.angle_degrees) * share;
+        l.observations += o.observations;
+        l.firstSeen = std::min(l.firstSeen, o.firstSeen);
+        l.lastSeen = std::max(l.lastSeen, o.lastSeen);
+        release(other);
+
+        std::uint64_t newCell = cellOf(l.point.x, l.point.y);
+        if (newCell != oldCell) {
+            removeFromCell(oldCell, id);
+            insertIntoCell(newCell, id);
+        }
+    }
+}
+
+void LandmarkMap::release(int id) {
+    removeFromCell(cellOf(items[id].point.x, items[id].point.y), id);
+    items[id].observations = 0;
+    freeSlots.push_back(id);
+}
+
+//drops corners that were seen too few times and not for a while, most likely noise or a passer-by
+void LandmarkMap::forgetStale(unsigned long frame) {
+    lastForget = frame;
+    for (size_t id = 0; id < items.size(); id++) {
+        Landmark& l = items[id];
+        if (l.observations == 0 || l.observations >= config.confirmObservations) continue;
+        if (frame - l.lastSeen < config.forgetFrames) continue;
+        release((int)id);
+    }
+}
+
+void LandmarkMap::findInRadius(double x, double y, double radius, std::vector<int>& ids) const {
+    ids.clear();
+    long minX = (long)std::floor((x - radius) * inverseCell), maxX = (long)std::floor((x + radius) * inverseCell);
+    long minY = (long)std::floor((y - radius) * inverseCell), maxY = (long)std::floor((y + radius) * inverseCell);
+    double radius2 = radius * radius;
+    for (long cy = minY; cy <= maxY; cy++) {
+        for (long cx = minX; cx <= maxX; cx++) {
+            auto found = cells.find(cellHash(cx, cy));
+            if (found == cells.end()) continue;
+            for (int id : found->second) {
+                double dx = items[id].point.x - x, dy = items[id].point.y - y;
+                if (dx * dx + dy * dy <= radius2) ids.push_back(id);
+            }
+        }
+    }
+}
+
+int LandmarkMap::nearest(double x, double y, double radius) const {
+    std::vector<int> ids;
+    findInRadius(x, y, radius, ids);
+    int best = -1;
+    double bestDistance = radius * radius;
+    for (int id : ids) {
+        double dx = items[id].point.x - x, dy = items[id].point.y - y;
+        double d = dx * dx + dy * dy;
+        if (d <= bestDistance) {
+            bestDistance = d;
+            best = id;
+        }
+    }
+    return best;
+}
+
+size_t LandmarkMap::confirmedCount() const {
+    size_t count = 0;
+    for (const Landmark& l : items)
+        if (l.observations >= config.confirmObservations) count++;
+    return count;
+}
+
+void LandmarkMap::clear() {
+    cells.clear();
+    items.clear();
+    freeSlots.clear();
+    nearby.clear();
+    lastForget = 0;
+}
+
+bool writeLandmarks(const LandmarkMap& map, const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Could not open " << filename << std::endl;
+        return false;
+    }
+    file << "# id x y angle_degrees observations\n";
+    const std::vector<Landmark>& items = map.landmarks();
+    for (size_t id = 0; id < items.size(); id++) {
+        if (items[id].observations == 0) continue;
+        file << id << " " << items[id].point.x << " " << items[id].point.y << " "
+             << items[id].angle_degrees << " " << items[id].observations << "\n";
+    }
+    return (bool)file;
+}
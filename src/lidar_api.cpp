@@ -0,0 +1,50 @@
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "lidar_api.h"
+#include "operations.h"
+#include "quantized.h"
+
+//polar to cartesian into the caller's array, beams that do not fit into capacity are left out
+size_t lidarConvert(RangeView<double> ranges, const Scan& scan, Point2D* points, size_t capacity) {
+    return convertToCarterisan(ranges.data, std::min(ranges.size, capacity), scan, points);
+}
+
+size_t lidarConvert(RangeView<float> ranges, const Scan& scan, Point2D* points, size_t capacity) {
+    return convertToCarterisan(ranges.data, std::min(ranges.size, capacity), scan, points);
+}
+
+size_t lidarConvert(RangeView<std::uint16_t> ranges, float scale, const Scan& scan, Point2D* points, size_t capacity) {
+    return convertQuantized(ranges.data, std::min(ranges.size, capacity), scale, scan, points);
+}
+
+//detection and intersections on points already in output, shared by both range types
+static void detectInOutput(const PipelineConfig& config, LidarOutput& output) {
+    Deadline deadline = Deadline::max();
+    if (config.detectionBudgetMs > 0)
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.detectionBudgetMs);
+    detectLines(output.points, config.ransac, deadline, output.stats, output.lines);
+    findValidIntersections(output.lines, output.points, config.minAngleThreshold, output.intersections);
+}
+
+//whole pipeline on the caller's ranges, no file and no copy of the ranges
+void lidarProcess(RangeView<double> ranges, const Scan& scan, const PipelineConfig& config, LidarOutput& output) {
+    //resize keeps the capacity from earlier frames, so this only allocates while frames grow
+    output.points.resize(ranges.size);
+    output.points.resize(convertToCarterisan(ranges.data, ranges.size, scan, output.points.data()));
+    detectInOutput(config, output);
+}
+
+void lidarProcess(RangeView<float> ranges, const Scan& scan, const PipelineConfig& config, LidarOutput& output) {
+    output.points.resize(ranges.size);
+    output.points.resize(convertToCarterisan(ranges.data, ranges.size, scan, output.points.data()));
+    detectInOutput(config, output);
+}
+
+void lidarProcess(RangeView<std::uint16_t> ranges, float scale, const Scan& scan, const PipelineConfig& config,
+                  LidarOutput& output) {
+    output.points.resize(ranges.size);
+    output.points.resize(convertQuantized(ranges.data, ranges.size, scale, scan, output.points.data()));
+    detectInOutput(config, output);
+}
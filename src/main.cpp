@@ -4,11 +4,22 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <memory>
+#include <algorithm>
 
 #include "constants.h"
 #include "file_read.h"
 #include "operations.h"
 #include "screen.h"
+#include "pipeline.h"
+#include "replay.h"
+#include "stream_pipeline.h"
+#include "instrument.h"
+#include "net_ingest.h"
+#include "shm_ring.h"
+#include "multi_sensor.h"
+#include "occupancy_grid.h"
+#include "result_writer.h"
 
 #define TEST_DATA "scan_data_NaN.toml"
 #define MERMELAT_URL "https://gist.githubusercontent.com/Mermalat/9b923dd7b053aa442fbc73b0f9d5d28a/raw/337861cf6c0a9ec2dcdf7a3cfbe119a19924e995/sdata"
@@ -20,125 +31,321 @@
 #define URL5 "http://abilgisayar.kocaeli.edu.tr/lidar5.toml"
 
 #define DOWNLOADED_FILE "downloaded_lidar.toml"
+#define FRAME_LIMIT 60 //maximum paints per second, the window only repaints when something changed
+#define DETECTION_BUDGET_MS 500 //wall-clock budget for line detection, partial results are kept after this
+#define TRACE_FILE "lidar_trace.json" //written at exit when built with -DLIDAR_INSTRUMENT
+#define RESULT_FLUSH_MS 1000 //live modes write buffered --out results at least this often, a killed run loses less
 
-void drawAllLines(sf::RenderWindow& window, sf::Font& font, 
-                  sf::Font& boldFont,
-                  const std::vector<Point2D>& dotsPOS,
-                  const std::vector<Line>& detectedLines) {
-    
-    for (size_t i = 0; i < detectedLines.size(); ++i) {
-        //draw points belonging to this line
-        for (int idx : detectedLines[i].pointIndices) {
-            Point2D point = dotsPOS[idx];
-            drawInRangeDots(window, font, point, 6, sf::Color::Green);
-        }
-        
-        //draw line segment
-        drawDetectedLine(window, dotsPOS, detectedLines[i], darkGreen);
-        
-        //add labels
-        if (!detectedLines[i].pointIndices.empty()) {
-            size_t midIdx = detectedLines[i].pointIndices.size() / 2;
-            Point2D midPoint = dotsPOS[detectedLines[i].pointIndices[midIdx]];
-            float screenX = convertCoordinateX(midPoint.x, gridscale);
-            float screenY = convertCoordinateY(midPoint.y, gridscale);
-            
-            std::string label = "L" + std::to_string(i + 1);
-            addText(window, boldFont, label, 12, sf::Color::Black, false, screenX, screenY - 15, false);
-        }
-    }
+//raw points that are on screen, read from the quadtree; dense areas come back as density cells
+void drawVisiblePoints(RenderBatch& batch, const FrameResult& frame, const Viewport& view,
+                       std::vector<int>& visiblePoints, std::vector<DensityCell>& densityCells) {
+    double minX, minY, maxX, maxY;
+    visibleWorldRect(view, minX, minY, maxX, maxY);
+    queryQuadTree(frame.tree, frame.points, minX, minY, maxX, maxY, densityCellPixels / view.scale,
+                  visiblePoints, densityCells);
+
+    for (const DensityCell& cell : densityCells)
+        drawDensityCell(batch, cell, darkGray, view);
+    for (int idx : visiblePoints)
+        drawInRangeDots(batch, frame.points[idx], darkGray, view);
+}
+
+//points of the lines from their own quadtree, so long walls zoomed out are a few cells too; then the segments
+void drawAllLines(RenderBatch& batch, const FrameResult& frame, const Viewport& view,
+                  std::vector<int>& visiblePoints, std::vector<DensityCell>& densityCells) {
+    double minX, minY, maxX, maxY;
+    visibleWorldRect(view, minX, minY, maxX, maxY);
+    queryQuadTree(frame.lineTree, frame.points, minX, minY, maxX, maxY, densityCellPixels / view.scale,
+                  visiblePoints, densityCells);
+
+    for (const DensityCell& cell : densityCells)
+        drawDensityCell(batch, cell, sf::Color::Green, view);
+    for (int idx : visiblePoints)
+        drawInRangeDots(batch, frame.points[idx], sf::Color::Green, view);
+
+    for (const Line& line : frame.lines)
+        drawDetectedLine(batch, frame.points, line, darkGreen, view);
 }
 
-void drawAllIntersections(sf::RenderWindow& window, sf::Font& arial,
-                         const std::vector<Intersection>& validIntersections) {
+void drawAllIntersections(RenderBatch& batch,
+                         const std::vector<Intersection>& validIntersections,
+                         const Viewport& view) {
     
     Point2D robotPos = {0.0, 0.0};
     
     for (const Intersection& inter : validIntersections) {
         // Draw dashed line from robot to intersection
-        drawDashedLineBetweenPoints(window, robotPos, inter.point, 
-                                   sf::Color::Red, 2.f, 10.f);
+        drawDashedLineBetweenPoints(batch, robotPos, inter.point, 
+                                   sf::Color::Red, view, 2.f, 10.f);
         
-        // Draw intersection marker with label
-        drawIntersectionMarker(window, arial, inter, true);
+        // Draw intersection marker
+        drawIntersectionMarker(batch, inter, view);
     }
 }
 
-void drawUIElements(sf::RenderWindow& window, sf::Font& arial) {
-    screen(window, 2.f, arial, margin_X, margin_Y, frame_X+margin_X, frame_Y+margin_Y);
-    mainFrame(window, arial, frame_X, frame_Y, margin_X, margin_Y, 2);
-    addText(window, arial, std::to_string((int)frame_X), 10, sf::Color::Black, 
-            false, frame_X/2+margin_X, margin_Y-30.f, false);
-    addText(window, arial, std::to_string((int)frame_Y), 10, sf::Color::Black, 
-            false, margin_X-50.f, screen_Y/2, false);
-}
+//console summary of one processed frame
+void printResults(const FrameResult& frame, bool localData, const std::string& url) {
+    const std::vector<Line>& detectedLines = frame.lines;
+    const RANSACstats& ransacStats = frame.stats;
 
-int main() {
-    //downloading TOML files from web
-    int choice;
-    std::string url;
-    bool localData = false;
-    std::cout << "which file you want to process?" << std::endl << "1 2 3 4 5 ";
-    std::cin >> choice;
-
-    if (choice == 1) url = URL1;
-    else if (choice == 2) url = URL2;
-    else if (choice == 3) url = URL3;
-    else if (choice == 4) url = URL4;
-    else if (choice == 5) url = URL5;
-    else if (choice == 10) url = MERMELAT_URL;
-    else localData = true;
-
-    std::cout << "Downloading TOML file from: " << url << std::endl;
-    if (!downloadTomlFile(url, DOWNLOADED_FILE)) {
-        std::cerr << "Failed to download TOML file. Using local test data instead." << std::endl;
-        localData = true;
-    }
+    std::cout << "\n=== RANSAC Results ===" << '\n';
+    std::cout << "Points: " << frame.points.size() << '\n';
+    std::cout << "Lines: " << detectedLines.size() << '\n';
+    std::cout << "Intersections: " << frame.intersections.size() << '\n';
+    std::cout << "Detection: " << ransacStats.elapsedMs << " ms, " << ransacStats.iterations << " iterations ("
+              << ransacStats.rejectedEarly << " rejected early), " << ransacStats.pointsRemaining << " points left" << (ransacStats.partial ? " (PARTIAL, deadline hit)" : "") << '\n';
+    if (frame.motion.valid)
+        std::cout << "Odometry: (" << frame.pose.x << ", " << frame.pose.y << ") yaw " << frame.pose.yaw * 180.0 / M1_P
+                  << " deg, match " << frame.motion.elapsedMs << " ms, " << frame.motion.iterations << " iterations, rms "
+                  << frame.motion.rms << '\n';
+    if (frame.landmarkCount)
+        std::cout << "Landmarks: " << frame.landmarkCount << " corners known" << '\n';
 
-    //choose which file to use
-    std::string dataFile;
-    if (localData) dataFile = TEST_DATA;
-    else dataFile = DOWNLOADED_FILE;
-    std::cout << "Using data file: " << dataFile << std::endl;
-
-    //Load the Head of the File, Lidar Scanned Parameters, Ranges and Intensities
-    Header header = readHeader(dataFile);
-    Scan scan = readScan(dataFile);
-    std::vector<double> rangesPositions = readRanges(dataFile);
-    std::vector<double> intensities = readIntensities(dataFile);
-    std::vector<Point2D> dotsPOS = convertToCarterisan(rangesPositions, scan);
-
-    RANSACparameters ransacConfig;
-    ransacConfig.minPoints = 8;              //minimum points to form a line
-    ransacConfig.distanceThreshold = 0.01;   //1 cm tolerance
-    ransacConfig.maxIterations = 10*10000;   //number of random samples
-
-    std::vector<Line> detectedLines = detectLines(dotsPOS, ransacConfig);
-    std::vector<Intersection> validIntersections = findValidIntersections(detectedLines, dotsPOS, 60.0);
-
-    std::cout << "\n=== RANSAC Results ===" << std::endl;
-    std::cout << "Points: " << dotsPOS.size() << std::endl;
-    std::cout << "Lines: " << detectedLines.size() << std::endl;
-    std::cout << "Intersections: " << validIntersections.size() << std::endl;
-
-    for (const auto& inter : validIntersections) {
+    for (size_t i = 0; i < frame.intersections.size(); i++) {
+        const Intersection& inter = frame.intersections[i];
         std::cout << "Intersection at world coords: (" << inter.point.x << ", " << inter.point.y << ")\n";
+        if (i < frame.landmarkIds.size() && frame.landmarkIds[i] >= 0)
+            std::cout << "  Landmark: " << frame.landmarkIds[i] << "\n";
 
         float screenX = convertCoordinateX(inter.point.x, gridscale);
         float screenY = convertCoordinateY(inter.point.y, gridscale);
 
-        std::cout << "Line " << inter.line1_idx+1 << ": " << detectedLines[inter.line1_idx].a << "x + "<< detectedLines[inter.line1_idx].b << "y + " << detectedLines[inter.line1_idx].c << std::endl;
-        std::cout << "Line " << inter.line2_idx+1 << ": " << detectedLines[inter.line2_idx].a << "x + "<< detectedLines[inter.line2_idx].b << "y + " << detectedLines[inter.line2_idx].c << std::endl;
+        std::cout << "Line " << inter.line1_idx+1 << ": " << detectedLines[inter.line1_idx].a << "x + "<< detectedLines[inter.line1_idx].b << "y + " << detectedLines[inter.line1_idx].c << '\n';
+        std::cout << "Line " << inter.line2_idx+1 << ": " << detectedLines[inter.line2_idx].a << "x + "<< detectedLines[inter.line2_idx].b << "y + " << detectedLines[inter.line2_idx].c << '\n';
         std::cout << "  Screen coords: (" << screenX << ", " << screenY << ")\n";
         std::cout << "  Between lines: " << inter.line1_idx+1 << " and " << inter.line2_idx+1 << "\n";
         std::cout << "  Angle: " << inter.angle_degrees << " degrees\n\n";
 
-        if (localData) std::cout << "Local Data Used" << std::endl;
-        else std::cout << "The Used URL: " << url << std::endl;
+        if (localData) std::cout << "Local Data Used" << '\n';
+        else std::cout << "The Used URL: " << url << '\n';
+    }
+    //one flush per frame instead of one per line
+    std::cout.flush();
+}
+
+//one line per fused frame: how long each sensor took and what the merge added
+void printSensorTimes(const FusedFrame& fused) {
+    std::cout << "Fused " << fused.sensors.size() << " sensors:";
+    for (const SensorStatus& sensor : fused.sensors)
+        std::cout << " " << sensor.frameId << " " << sensor.processMs << " ms" << (sensor.fresh ? "" : " (stale)") << ",";
+    std::cout << " fuse " << fused.fuseMs << " ms, latency " << fused.latencyMs << " ms" << std::endl;
+}
+
+//socket ingest counters, so packets lost on the way or too broken to read show up while it runs
+void printIngestCounters(const NetIngest& ingest) {
+    std::cout << "Ingest: " << ingest.received() << " received, " << ingest.dropped() << " dropped (ring full), "
+              << ingest.stale() << " stale, " << ingest.malformed() << " malformed" << std::endl;
+}
+
+//RANSAC settings every mode uses
+PipelineConfig defaultPipelineConfig() {
+    PipelineConfig pipelineConfig;
+    pipelineConfig.ransac.minPoints = 8;              //minimum points to form a line
+    pipelineConfig.ransac.distanceThreshold = 0.01;   //1 cm tolerance
+    pipelineConfig.ransac.maxIterations = 10*10000;   //number of random samples
+    pipelineConfig.ransac.earlyRejection = true;      //sequential test, same lines in far less time
+    pipelineConfig.minAngleThreshold = 60.0;
+    pipelineConfig.detectionBudgetMs = DETECTION_BUDGET_MS;
+    return pipelineConfig;
+}
+
+int main(int argc, char* argv[]) {
+    //structured results next to any mode: --out <file.ndjson|file.csv|file.bin> anywhere on the command line
+    ResultWriter resultWriter;
+    bool writeResults = false;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) != "--out") continue;
+        std::string resultFile = argv[i + 1];
+        //the other options are positional, so take these two out of the way
+        for (int j = i; j + 2 < argc; j++) argv[j] = argv[j + 2];
+        argc -= 2;
+        //the map has no per-frame detection results, checked before the file is created
+        if (argc >= 2 && std::string(argv[1]) == "--map") {
+            std::cerr << "--out does not apply to --map, it writes map tiles" << std::endl;
+            return -1;
+        }
+        if (!resultWriter.open(resultFile, resultFormatFor(resultFile))) return -1;
+        writeResults = true;
+        break;
+    }
+    auto recordResult = [&](const FrameResult& frame) {
+        if (writeResults) resultWriter.write(frame);
+    };
+    auto finishResults = [&] {
+        if (!writeResults) return;
+        bool ok = resultWriter.close();
+        std::cout << "Results: " << resultWriter.framesWritten() << " frames, " << resultWriter.bytesWritten() << " bytes"
+                  << (ok ? "" : " (WRITE FAILED)") << std::endl;
+    };
+
+    //headless replay of a multi-frame log: main --replay <log.toml> [speed], speed 0 = as fast as possible
+    if (argc >= 3 && std::string(argv[1]) == "--replay") {
+        ReplayConfig replayConfig;
+        if (argc >= 4) replayConfig.speed = std::stod(argv[3]);
+
+        std::vector<QuantizedFrame> frames = readScanLogQuantized(argv[2]);
+        if (frames.empty()) {
+            std::cerr << "No scans found in " << argv[2] << std::endl;
+            return -1;
+        }
+        std::cout << "Replaying " << frames.size() << " scans at "
+                  << (replayConfig.speed > 0 ? std::to_string(replayConfig.speed) + "x" : "max speed") << std::endl;
+        printReplayReport(replayLog(frames, defaultPipelineConfig(), replayConfig, recordResult));
+        finishResults();
+        finishInstrumentation(TRACE_FILE);
+        return 0;
+    }
+
+    //headless throughput run with every stage on its own threads: main --stream <log.toml> [detect workers] [unordered]
+    if (argc >= 3 && std::string(argv[1]) == "--stream") {
+        StreamConfig streamConfig;
+        if (argc >= 4) streamConfig.detectWorkers = std::stoi(argv[3]);
+        if (argc >= 5 && std::string(argv[4]) == "unordered") streamConfig.inOrder = false;
+
+        std::vector<std::string> blocks = readFrameBlocks(argv[2]);
+        if (blocks.empty()) {
+            std::cerr << "No scans found in " << argv[2] << std::endl;
+            return -1;
+        }
+        std::cout << "Streaming " << blocks.size() << " scans with " << streamConfig.detectWorkers
+                  << " detect workers" << std::endl;
+        printStreamReport(runStreamPipeline(blocks, defaultPipelineConfig(), streamConfig, recordResult));
+        finishResults();
+        finishInstrumentation(TRACE_FILE);
+        return 0;
+    }
+
+    //occupancy grid of a whole log, placed by scan matching: main --map <log.toml> [tile directory]
+    if (argc >= 3 && std::string(argv[1]) == "--map") {
+        std::string directory = argc >= 4 ? argv[3] : "map_tiles";
+        std::vector<QuantizedFrame> frames = readScanLogQuantized(argv[2]);
+        if (frames.empty()) {
+            std::cerr << "No scans found in " << argv[2] << std::endl;
+            return -1;
+        }
+
+        ScanOdometry odometry;
+        OccupancyGrid grid;
+        std::vector<Point2D> points;
+        std::vector<double> frameMs;
+        for (const QuantizedFrame& frame : frames) {
+            points.resize(frame.ranges.size());
+            points.resize(convertQuantized(frame.ranges.data(), frame.ranges.size(), frame.rangeScale, frame.scan,
+                                           points.data()));
+            odometry.addScan(points, {});
+
+            sf::Clock clock;
+            grid.integrate(odometry.pose(), points.data(), points.size());
+            frameMs.push_back(clock.getElapsedTime().asMicroseconds() / 1000.0);
+        }
+        std::sort(frameMs.begin(), frameMs.end());
+
+        int written = exportDirtyTiles(grid, directory);
+        writeMapPgm(grid, directory + "/map.pgm");
+        std::cout << "Mapped " << frames.size() << " scans into " << grid.tileCount() << " tiles, "
+                  << frameMs[frameMs.size() / 2] << " ms per scan (p50), " << frameMs.back() << " ms max" << std::endl;
+        std::cout << "Wrote " << written << " tiles and map.pgm to " << directory << std::endl;
+        finishInstrumentation(TRACE_FILE);
+        return 0;
     }
 
+    //the window modes draw their frames, so they need the quadtrees
+    PipelineConfig pipelineConfig = defaultPipelineConfig();
+    pipelineConfig.buildTrees = true;
+    std::string url;
+    bool localData = false;
+    std::unique_ptr<NetIngest> ingest;
+    std::unique_ptr<ShmRingReader> shmReader;
+    std::unique_ptr<ProcessingWorker> worker;
+    std::unique_ptr<MultiSensorWorker> multiWorker;
+
+    //live scans from a local socket: main --listen udp|tcp <port>
+    if (argc >= 4 && std::string(argv[1]) == "--listen") {
+        IngestConfig ingestConfig;
+        ingestConfig.protocol = std::string(argv[2]) == "tcp" ? IngestProtocol::Tcp : IngestProtocol::Udp;
+        ingestConfig.port = (unsigned short) std::stoi(argv[3]);
+        ingest.reset(new NetIngest(ingestConfig));
+        if (!ingest->start()) return -1;
+        url = std::string(argv[2]) + " port " + argv[3];
+        std::cout << "Listening for scans on " << url << std::endl;
+
+        NetIngest* source = ingest.get();
+        worker.reset(new ProcessingWorker(
+            [source](Header& header, Scan& scan, std::vector<Point2D>& points) {
+                return source->decodeNext(header, scan, points);
+            }, pipelineConfig));
+    }
+    //driver on the same machine writing into shared memory: main --shm [name]
+    else if (argc >= 2 && std::string(argv[1]) == "--shm") {
+        std::string name = argc >= 3 ? argv[2] : shmDefaultName;
+        shmReader.reset(new ShmRingReader());
+        if (!shmReader->open(name)) return -1;
+        url = "shared memory " + name;
+        std::cout << "Reading scans from " << url << std::endl;
+
+        ShmRingReader* source = shmReader.get();
+        worker.reset(new ProcessingWorker(
+            [source](Header& header, Scan& scan, std::vector<Point2D>& points) {
+                return source->readLatest(header, scan, points);
+            }, pipelineConfig));
+    }
+    //several sensors, each file on its own worker: main --multi <extrinsics.toml> fused|split <scan.toml>...
+    else if (argc >= 5 && std::string(argv[1]) == "--multi") {
+        std::map<std::string, Extrinsic> extrinsics;
+        if (!readExtrinsics(argv[2], extrinsics)) return -1;
+        FusionMode mode = std::string(argv[3]) == "split" ? FusionMode::PerSensor : FusionMode::Fused;
+
+        std::vector<FrameSource> sources;
+        for (int i = 4; i < argc; i++) sources.push_back(watchTomlFile(argv[i]));
+        localData = true;
+        std::cout << "Fusing " << sources.size() << " sensors, detection "
+                  << (mode == FusionMode::Fused ? "on the fused cloud" : "per sensor") << std::endl;
+        multiWorker.reset(new MultiSensorWorker(sources, extrinsics, pipelineConfig, mode));
+    }
+    else {
+        //downloading TOML files from web
+        int choice;
+        std::cout << "which file you want to process?" << std::endl << "1 2 3 4 5 ";
+        std::cin >> choice;
+
+        if (choice == 1) url = URL1;
+        else if (choice == 2) url = URL2;
+        else if (choice == 3) url = URL3;
+        else if (choice == 4) url = URL4;
+        else if (choice == 5) url = URL5;
+        else if (choice == 10) url = MERMELAT_URL;
+        else localData = true;
+
+        std::cout << "Downloading TOML file from: " << url << std::endl;
+        if (!downloadTomlFile(url, DOWNLOADED_FILE)) {
+            std::cerr << "Failed to download TOML file. Using local test data instead." << std::endl;
+            localData = true;
+        }
+
+        //choose which file to use
+        std::string dataFile;
+        if (localData) dataFile = TEST_DATA;
+        else dataFile = DOWNLOADED_FILE;
+        std::cout << "Using data file: " << dataFile << std::endl;
+
+        //the data file is read again whenever it changes on disk
+        worker.reset(new ProcessingWorker(watchTomlFile(dataFile), pipelineConfig));
+    }
+
+    //parsing and detection run on worker threads, the window shows whatever frame is newest
+    if (multiWorker) multiWorker->start();
+    else worker->start();
+
+    //settings changed from the keyboard; the frame on screen is redone on its own thread, newer frames use them too
+    TuningState tuning;
+    tuning.config = tuning.initial = pipelineConfig;
+    RetuneWorker retune;
+    retune.start();
+    //newest frame from the workers, shared with the retune worker; older retune results are dropped
+    std::shared_ptr<FrameResult> sourceFrame;
+
     //create the window for drawing
-    sf::RenderWindow window(sf::VideoMode({(unsigned int) screen_X, (unsigned int) screen_Y}), header.frame_id + " " + header.stamp);
+    sf::RenderWindow window(sf::VideoMode({(unsigned int) screen_X, (unsigned int) screen_Y}), "lidar");
 
     //loading font
     sf::Font arial;
@@ -148,37 +355,139 @@ int main() {
         return -1;
     }
 
+    //pan and zoom, the grid and labels are rebuilt when it changes
+    Viewport view;
+    unsigned long viewVersion = 1;
+
+    //grid and axes are drawn once per view, the scene geometry is collected into a few vertex batches
+    StaticLayer staticLayer;
+    if (!buildStaticLayer(staticLayer, arial, view)) return -1;
+    RenderBatch batch;
+    std::vector<int> visiblePoints;
+    std::vector<DensityCell> densityCells;
+
+    //text is laid out again only when a new frame comes in
+    LabelCache labelCache;
+    FrameResult emptyFrame;
+    const FrameResult* frame = &emptyFrame;
+    //a retune result keeps the sequence of its source frame, so the labels follow this instead
+    unsigned long displayVersion = 1;
+
+    sf::Clock resultFlushClock;
+
+    //repaint only when something changed, never faster than the frame limit
+    RedrawPolicy redraw;
+    redraw.frameLimit = FRAME_LIMIT;
+    window.setFramerateLimit(redraw.frameLimit);
+    FrameStats frameStats;
+
     //main loop for screen
     while (window.isOpen()) {
+        //sleep until an event arrives; the timeout wakes us up to look for new frames
+        sf::Time waitTime = redraw.frameLimit ? sf::seconds(1.f / redraw.frameLimit) : sf::milliseconds(1);
+        std::optional<sf::Event> event = window.waitEvent(waitTime);
+
         //handle events
-        while (std::optional<sf::Event> event = window.pollEvent()) {
+        while (event) {
             if (event->is<sf::Event::Closed>())
                 window.close();
             if (auto key = event->getIf<sf::Event::KeyPressed>()) {
                 if (key->code == sf::Keyboard::Key::Escape)
                     window.close();
             }
+            if (eventNeedsRedraw(*event)) redraw.dirty = true;
+            if (event->is<sf::Event::KeyPressed>()) {
+                StaleStages stale = handleTuningEvent(tuning, *event);
+                if (stale != StaleStages::None) {
+                    if (multiWorker) multiWorker->setConfig(tuning.config);
+                    else worker->setConfig(tuning.config);
+                    if (sourceFrame) retune.request(sourceFrame, tuning.config, stale == StaleStages::Detection);
+                }
+                redraw.dirty = true;
+            }
+            if (handleViewportEvent(view, *event, window)) {
+                viewVersion++;
+                redraw.dirty = true;
+            }
+            event = window.pollEvent();
         }
-        
+        if (!window.isOpen()) break;
+
+        //the grid follows the view
+        if (staticLayer.viewVersion != viewVersion) {
+            buildStaticLayer(staticLayer, arial, view);
+            staticLayer.viewVersion = viewVersion;
+        }
+
+        //pick up the latest complete frame without waiting for the worker
+        if (multiWorker ? multiWorker->update() : worker->update()) {
+            //swapped out of the worker's buffer, not copied; the buffer gets the previous frame's memory back
+            //unless the retune worker still holds it
+            if (!sourceFrame || sourceFrame.use_count() > 1) sourceFrame = std::make_shared<FrameResult>();
+            std::swap(*sourceFrame, multiWorker ? multiWorker->latest().result : worker->latest());
+            frame = sourceFrame.get();
+            printResults(*frame, localData, url);
+            recordResult(*frame);
+            if (writeResults && resultFlushClock.getElapsedTime().asMilliseconds() >= RESULT_FLUSH_MS) {
+                resultWriter.flush();
+                resultFlushClock.restart();
+            }
+            if (multiWorker) printSensorTimes(multiWorker->latest());
+            if (ingest) printIngestCounters(*ingest);
+            window.setTitle(frame->header.frame_id + " " + frame->header.stamp);
+            displayVersion++;
+            redraw.dirty = true;
+            //a frame that started before the last change is redone with the current settings
+            if (sameSettings(frame->config, tuning.config)) retune.cancel();
+            else retune.request(sourceFrame, tuning.config, false);
+        }
+        if (retune.update() && sourceFrame && retune.latest().sequence == sourceFrame->sequence) {
+            frame = &retune.latest();
+            printResults(*frame, localData, url);
+            displayVersion++;
+            redraw.dirty = true;
+        }
+        if (tuning.busy != retune.busy()) {
+            tuning.busy = retune.busy();
+            redraw.dirty = true;
+        }
+
+        if (updateFrameStats(frameStats, redraw)) redraw.dirty = true;
+        if (!redraw.dirty) continue;
+
+        sf::Clock frameClock;
         window.clear(sf::Color::White);
 
         //draw everything in layers
-        drawUIElements(window, arial);
+        drawStaticLayer(window, staticLayer);
         
-        //draw all raw points
-        for (Point2D point : dotsPOS)
-            drawInRangeDots(window, arial, point, 5, darkGray);
+        //collect visible raw points, detected lines and intersections, then draw them at once
+        clearBatch(batch);
+        drawVisiblePoints(batch, *frame, view, visiblePoints, densityCells);
+        drawAllLines(batch, *frame, view, visiblePoints, densityCells);
+        drawAllIntersections(batch, frame->intersections, view);
+        drawBatchInFrame(window, batch);
 
-        //draw detected lines 
-        drawAllLines(window, arial, boldArial, dotsPOS, detectedLines);
-        
-        //draw intersections
-        drawAllIntersections(window, arial, validIntersections);
+        //labels and legend go on top of the geometry, relaid only when the result or the view changes
+        updateLabelCache(labelCache, arial, boldArial, frame->points, frame->lines, frame->intersections,
+                         displayVersion, view, viewVersion);
+        drawLabelCache(window, labelCache);
         
-        //draw robot and legend
-        robot(window, boldArial);
-        drawLegend(window, arial, detectedLines.size(), validIntersections.size(), detectedLines, dotsPOS, validIntersections);
+        //draw robot
+        robot(window, boldArial, view);
+        drawFrameStats(window, arial, frameStats);
+        drawTuningHud(window, arial, tuning, frame->stats);
 
+        recordFrame(frameStats, frameClock.getElapsedTime().asMicroseconds() / 1000.f);
         window.display();
+        redraw.dirty = false;
     }
-}
+
+    //the reports read every thread's records, so the worker has to be done first
+    retune.stop();
+    if (multiWorker) multiWorker->stop();
+    else worker->stop();
+    if (ingest) printIngestCounters(*ingest);
+    finishResults();
+    finishInstrumentation(TRACE_FILE);
+}
\ No newline at end of file
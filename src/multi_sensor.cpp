@@ -0,0 +1,267 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#include "multi_sensor.h"
+#include "instrument.h"
+
+static double steadySeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool readExtrinsics(const std::string& filename, std::map<std::string, Extrinsic>& extrinsics) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Extrinsics file couldn't be found: " << filename << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || line[0] == '[' || equals == std::string::npos) continue;
+
+        std::istringstream name(line.substr(0, equals)), values(line.substr(equals + 1));
+        std::string frameId;
+        Extrinsic extrinsic;
+        double yawDegrees = 0;
+        name >> frameId;
+        //frame ids may be quoted like in the scan files
+        if (frameId.size() >= 2 && frameId.front() == '"' && frameId.back() == '"')
+            frameId = frameId.substr(1, frameId.size() - 2);
+        if (!(values >> extrinsic.x >> extrinsic.y >> yawDegrees)) {
+            std::cerr << "Bad extrinsic line: " << line << std::endl;
+            return false;
+        }
+        extrinsic.yaw = yawDegrees * M1_P / 180.0;
+        extrinsics[frameId] = extrinsic;
+    }
+    return true;
+}
+
+void transformPoints(const Extrinsic& extrinsic, Point2D* points, size_t count) {
+    double c = std::cos(extrinsic.yaw), s = std::sin(extrinsic.yaw);
+    for (size_t i = 0; i < count; i++) {
+        double x = points[i].x, y = points[i].y;
+        points[i].x = c * x - s * y + extrinsic.x;
+        points[i].y = s * x + c * y + extrinsic.y;
+    }
+}
+
+//the quadtree is left in the sensor frame, the fused frame builds its own over every point
+void transformResult(const Extrinsic& extrinsic, FrameResult& result) {
+    transformPoints(extrinsic, result.points.data(), result.points.size());
+
+    //ax + by + c = 0: the normal (a, b) rotates with the sensor, c moves with its position
+    double cs = std::cos(extrinsic.yaw), sn = std::sin(extrinsic.yaw);
+    for (Line& line : result.lines) {
+        double a = cs * line.a - sn * line.b;
+        double b = sn * line.a + cs * line.b;
+        line.c -= a * extrinsic.x + b * extrinsic.y;
+        line.a = a;
+        line.b = b;
+    }
+    for (Intersection& inter : result.intersections) {
+        transformPoints(extrinsic, &inter.point, 1);
+        inter.distance_to_robot = std::hypot(inter.point.x, inter.point.y);
+    }
+}
+
+MultiSensorWorker::MultiSensorWorker(const std::vector<FrameSource>& sources,
+                                     const std::map<std::string, Extrinsic>& extrinsics,
+                                     const PipelineConfig& config, FusionMode mode)
+    : extrinsics(extrinsics), config(config), mode(mode) {
+    for (const FrameSource& source : sources) {
+        sensors.emplace_back(new Sensor());
+        sensors.back()->source = source;
+    }
+}
+
+MultiSensorWorker::~MultiSensorWorker() {
+    stop();
+}
+
+void MultiSensorWorker::start() {
+    if (running) return;
+    running = true;
+    for (auto& sensor : sensors) sensor->thread = std::thread(&MultiSensorWorker::runSensor, this, std::ref(*sensor));
+    fusionThread = std::thread(&MultiSensorWorker::runFusion, this);
+}
+
+void MultiSensorWorker::stop() {
+    running = false;
+    wake.notify_all();
+    for (auto& sensor : sensors)
+        if (sensor->thread.joinable()) sensor->thread.join();
+    if (fusionThread.joinable()) fusionThread.join();
+}
+
+void MultiSensorWorker::setConfig(const PipelineConfig& config) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    this->config = config;
+}
+
+PipelineConfig MultiSensorWorker::currentConfig() {
+    std::lock_guard<std::mutex> lock(configMutex);
+    return config;
+}
+
+bool MultiSensorWorker::update() {
+    return fused.update();
+}
+
+const FusedFrame& MultiSensorWorker::latest() const {
+    return fused.readBuffer();
+}
+
+FusedFrame& MultiSensorWorker::latest() {
+    return fused.readBuffer();
+}
+
+Extrinsic MultiSensorWorker::extrinsicFor(const std::string& frameId) const {
+    auto it = extrinsics.find(frameId);
+    return it == extrinsics.end() ? Extrinsic() : it->second;
+}
+
+//one per sensor: pull a frame, bring it into the common frame, hand it to the fusion thread
+void MultiSensorWorker::runSensor(Sensor& sensor) {
+    RawFrame raw;
+    unsigned long count = 0;
+    while (running) {
+        if (!sensor.source(raw)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+
+        SensorFrame& frame = sensor.frames.writeBuffer();
+        frame.startedAt = steadySeconds();
+        FrameResult& result = frame.result;
+        if (mode == FusionMode::PerSensor) {
+            //the trees are built once on the merged frame
+            PipelineConfig sensorConfig = currentConfig();
+            sensorConfig.buildTrees = false;
+            processFrame(raw, sensorConfig, result);
+        }
+        else {
+            result.header = raw.header;
+            result.scan = raw.scan;
+            result.points.resize(raw.ranges.size());
+            result.points.resize(convertToCarterisan(raw.ranges.data(), raw.ranges.size(), raw.scan, result.points.data()));
+        }
+        transformResult(extrinsicFor(raw.header.frame_id), result);
+        result.sequence = ++count;
+
+        frame.status.frameId = raw.header.frame_id;
+        frame.status.stamp = raw.header.stamp;
+        frame.status.points = result.points.size();
+        frame.status.processMs = (steadySeconds() - frame.startedAt) * 1000;
+        sensor.frames.publish();
+
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            published++;
+        }
+        wake.notify_one();
+    }
+}
+
+/*
+- Fuses once every sensor has a new frame, so the output rate follows the slowest sensor
+- and the latency is that of the slowest sensor plus the merge, not the sum of all of them.
+- A sensor that has gone quiet is waited for at most maxWaitMs, then its last frame is used.
+*/
+void MultiSensorWorker::runFusion() {
+    std::vector<bool> fresh(sensors.size(), false);
+    double firstFresh = 0;
+    unsigned long seen = 0;
+
+    while (running) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(5), [&] { return published != seen || !running; });
+            seen = published;
+        }
+
+        bool any = false, all = true;
+        for (size_t i = 0; i < sensors.size(); i++) {
+            if (sensors[i]->frames.update()) fresh[i] = true;
+            any = any || fresh[i];
+            all = all && fresh[i];
+        }
+        if (!any) continue;
+        if (firstFresh == 0) firstFresh = steadySeconds();
+        if (!all && (steadySeconds() - firstFresh) * 1000 < maxWaitMs) continue;
+
+        double start = steadySeconds();
+        double oldest = start;
+        //one snapshot for the whole step, so the frame never claims settings it was not detected with
+        PipelineConfig frameConfig = currentConfig();
+        FusedFrame& out = fused.writeBuffer();
+        FrameResult& result = out.result;
+        result.points.clear();
+        result.lines.clear();
+        result.intersections.clear();
+        result.stats = RANSACstats();
+        result.config = frameConfig;
+        out.sensors.clear();
+
+        for (size_t i = 0; i < sensors.size(); i++) {
+            const SensorFrame& frame = sensors[i]->frames.readBuffer();
+            if (frame.result.sequence == 0) continue;   //nothing from this sensor yet
+            if (fresh[i]) oldest = std::min(oldest, frame.startedAt);
+            out.sensors.push_back(frame.status);
+            out.sensors.back().fresh = fresh[i];
+            if (out.sensors.size() == 1) {
+                result.header = frame.result.header;
+                result.scan = frame.result.scan;
+            }
+            else if (frame.result.header.stamp > result.header.stamp) {
+                result.header.stamp = frame.result.header.stamp;
+            }
+
+            //indices in lines and intersections move by what the sensors before this one added
+            int pointOffset = (int)result.points.size();
+            int lineOffset = (int)result.lines.size();
+            result.points.insert(result.points.end(), frame.result.points.begin(), frame.result.points.end());
+            if (mode == FusionMode::Fused) continue;
+
+            //a sensor still on older settings marks the whole frame, so the window redoes it
+            if (!sameSettings(frame.result.config, result.config)) result.config = frame.result.config;
+            for (const Line& line : frame.result.lines) {
+                result.lines.push_back(line);
+                for (int& idx : result.lines.back().pointIndices) idx += pointOffset;
+            }
+            for (const Intersection& inter : frame.result.intersections) {
+                result.intersections.push_back(inter);
+                result.intersections.back().line1_idx += lineOffset;
+                result.intersections.back().line2_idx += lineOffset;
+            }
+            const RANSACstats& stats = frame.result.stats;
+            result.stats.partial = result.stats.partial || stats.partial;
+            result.stats.iterations += stats.iterations;
+            result.stats.linesFound += stats.linesFound;
+            result.stats.pointsRemaining += stats.pointsRemaining;
+            result.stats.elapsedMs = std::max(result.stats.elapsedMs, stats.elapsedMs);
+        }
+        result.header.frame_id = "fused";
+
+        {
+            LIDAR_SCOPE("fuse");
+            if (mode == FusionMode::Fused) processPoints(frameConfig, result);
+            else buildDisplayTrees(frameConfig, result);
+        }
+
+        double end = steadySeconds();
+        out.fuseMs = (end - start) * 1000;
+        out.latencyMs = (end - oldest) * 1000;
+        result.sequence = ++sequence;
+        fused.publish();
+
+        std::fill(fresh.begin(), fresh.end(), false);
+        firstFresh = 0;
+    }
+}
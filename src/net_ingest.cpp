@@ -0,0 +1,352 @@
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#include "net_ingest.h"
+#include "operations.h"
+
+//small wrappers so the rest of the file does not care about the platform
+static bool initSockets() {
+#ifdef _WIN32
+    static bool ready = false;
+    if (!ready) {
+        WSADATA data;
+        ready = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }
+    return ready;
+#else
+    return true;
+#endif
+}
+
+static void closeSocket(std::intptr_t s) {
+    if (s < 0) return;
+#ifdef _WIN32
+    closesocket((SOCKET)s);
+#else
+    ::close((int)s);
+#endif
+}
+
+//receive calls give up after this long so stop() never waits on a silent socket
+static void setReceiveTimeout(std::intptr_t s, int ms) {
+#ifdef _WIN32
+    DWORD timeout = ms;
+#else
+    timeval timeout = {ms / 1000, (ms % 1000) * 1000};
+#endif
+    setsockopt((int)s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+size_t scanPacketSize(size_t rangeCount) {
+    return sizeof(ScanPacketHeader) + rangeCount * sizeof(float);
+}
+
+size_t ingestSlotSize(const IngestConfig& config) {
+    size_t size = scanPacketSize(config.maxBeams);
+    if (config.protocol == IngestProtocol::Udp) size = std::min(size, maxDatagramSize);
+    return size;
+}
+
+//fixed size text field: cut off at the field size, no terminator when it is full, zeros after the text
+static void copyTextField(char* field, size_t fieldSize, const std::string& text) {
+    size_t length = std::min(text.size(), fieldSize);
+    std::memcpy(field, text.data(), length);
+    std::memset(field + length, 0, fieldSize - length);
+}
+
+//builds one packet; ranges go out as float32, which is well below the sensor's noise
+size_t encodeScanPacket(const Header& header, const Scan& scan, const std::vector<double>& ranges,
+                        std::uint32_t sequence, std::vector<char>& packet) {
+    ScanPacketHeader h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = scanPacketMagic;
+    h.version = scanPacketVersion;
+    h.headerSize = sizeof(ScanPacketHeader);
+    h.sequence = sequence;
+    h.rangeCount = ranges.size();
+    copyTextField(h.stamp, sizeof(h.stamp), header.stamp);
+    copyTextField(h.frameId, sizeof(h.frameId), header.frame_id);
+    h.angle_min = scan.angle_min;
+    h.angle_max = scan.angle_max;
+    h.angle_increment = scan.angle_increment;
+    h.time_increment = scan.time_increment;
+    h.scan_time = scan.scan_time;
+    h.range_min = scan.range_min;
+    h.range_max = scan.range_max;
+
+    packet.resize(scanPacketSize(ranges.size()));
+    std::memcpy(packet.data(), &h, sizeof(h));
+    float* out = (float*)(packet.data() + sizeof(h));
+    for (size_t i = 0; i < ranges.size(); i++) out[i] = (float)ranges[i];
+    return packet.size();
+}
+
+//checks a packet and points into it, the ranges are not copied
+bool decodeScanPacket(const char* packet, size_t size, Header& header, Scan& scan,
+                      const float*& ranges, size_t& rangeCount) {
+    if (size < sizeof(ScanPacketHeader)) return false;
+    const ScanPacketHeader* h = (const ScanPacketHeader*)packet;
+    if (h->magic != scanPacketMagic || h->version != scanPacketVersion) return false;
+    if (h->headerSize < sizeof(ScanPacketHeader) || h->headerSize > size) return false;
+    if (size < h->headerSize + (size_t)h->rangeCount * sizeof(float)) return false;
+
+    header.stamp.assign(h->stamp, strnlen(h->stamp, sizeof(h->stamp)));
+    header.frame_id.assign(h->frameId, strnlen(h->frameId, sizeof(h->frameId)));
+    scan.angle_min = h->angle_min;
+    scan.angle_max = h->angle_max;
+    scan.angle_increment = h->angle_increment;
+    scan.time_increment = h->time_increment;
+    scan.scan_time = h->scan_time;
+    scan.range_min = h->range_min;
+    scan.range_max = h->range_max;
+
+    ranges = (const float*)(packet + h->headerSize);
+    rangeCount = h->rangeCount;
+    return true;
+}
+
+NetIngest::NetIngest(const IngestConfig& config) : config(config) {
+    //all packet memory is allocated once here, nothing is allocated per scan
+    slots.resize(config.slotCount);
+    for (PacketSlot& slot : slots) slot.data.resize(ingestSlotSize(config));
+}
+
+NetIngest::~NetIngest() {
+    stop();
+}
+
+bool NetIngest::start() {
+    if (running) return true;
+    if (!initSockets()) {
+        std::cerr << "Socket library could not be initialized" << std::endl;
+        return false;
+    }
+
+    bool udp = config.protocol == IngestProtocol::Udp;
+    listenSocket = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        std::cerr << "Socket could not be created" << std::endl;
+        return false;
+    }
+
+    int yes = 1;
+    setsockopt((int)listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    if (udp) {
+        //room for a burst of scans while the receiver thread is descheduled
+        int bufferSize = 4 * 1024 * 1024;
+        setsockopt((int)listenSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+    }
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); //local socket only
+    address.sin_port = htons(config.port);
+    if (bind((int)listenSocket, (sockaddr*)&address, sizeof(address)) != 0 ||
+        (!udp && listen((int)listenSocket, 1) != 0)) {
+        std::cerr << "Could not listen on port " << config.port << std::endl;
+        closeSocket(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    setReceiveTimeout(listenSocket, 100);
+
+    running = true;
+    thread = std::thread(&NetIngest::receiveLoop, this);
+    return true;
+}
+
+void NetIngest::stop() {
+    running = false;
+    if (thread.joinable()) thread.join();
+    closeSocket(clientSocket);
+    closeSocket(listenSocket);
+    clientSocket = -1;
+    listenSocket = -1;
+}
+
+//single producer: fills the slot at head and only then moves head forward
+void NetIngest::receiveLoop() {
+    //scratch slot for packets that arrive while the ring is full, so the socket is still drained
+    PacketSlot overflow;
+    overflow.data.resize(ingestSlotSize(config));
+
+    while (running) {
+        size_t h = head.load(std::memory_order_relaxed);
+        bool full = h - tail.load(std::memory_order_acquire) >= slots.size();
+        PacketSlot& slot = full ? overflow : slots[h % slots.size()];
+
+        bool ok = config.protocol == IngestProtocol::Udp ? receiveUdp(slot) : receiveTcp(slot);
+        if (!ok) continue;
+
+        Header header;
+        Scan scan;
+        const float* ranges;
+        size_t count;
+        if (!decodeScanPacket(slot.data.data(), slot.size, header, scan, ranges, count)) {
+            malformedCount++;
+            continue;
+        }
+        receivedCount++;
+        if (full) {
+            droppedCount++;
+            continue;
+        }
+        head.store(h + 1, std::memory_order_release);
+    }
+}
+
+//one datagram is one scan, the kernel copies it right into the ring slot
+bool NetIngest::receiveUdp(PacketSlot& slot) {
+    int n = recv((int)listenSocket, slot.data.data(), (int)slot.data.size(), 0);
+    if (n <= 0) return false;
+    slot.size = n;
+    return true;
+}
+
+//reads exactly size bytes from the connected client: 1 when done, 0 when nothing came in time, -1 when the connection broke
+int NetIngest::readExact(char* buffer, size_t size) {
+    size_t done = 0;
+    while (done < size && running) {
+        int n = recv((int)clientSocket, buffer + done, (int)(size - done), 0);
+        if (n == 0) return -1; //client went away
+        if (n < 0) {
+#ifdef _WIN32
+            bool timeout = WSAGetLastError() == WSAETIMEDOUT;
+#else
+            bool timeout = errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+            if (timeout && done == 0) return 0; //nothing waiting, let the loop check running
+            if (timeout) continue;              //in the middle of a packet, keep reading
+            return -1;
+        }
+        done += n;
+    }
+    return done == size ? 1 : 0;
+}
+
+//TCP carries the same packets back to back; the header tells how many ranges follow
+bool NetIngest::receiveTcp(PacketSlot& slot) {
+    if (clientSocket < 0) {
+        clientSocket = accept((int)listenSocket, nullptr, nullptr);
+        if (clientSocket < 0) return false;
+        int yes = 1;
+        setsockopt((int)clientSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+        setReceiveTimeout(clientSocket, 100);
+    }
+
+    char* buffer = slot.data.data();
+    int status = readExact(buffer, sizeof(ScanPacketHeader));
+    if (status <= 0) {
+        //a plain timeout keeps the connection, anything else drops it
+        if (status < 0) {
+            closeSocket(clientSocket);
+            clientSocket = -1;
+        }
+        return false;
+    }
+
+    const ScanPacketHeader* h = (const ScanPacketHeader*)buffer;
+    size_t total = (size_t)h->headerSize + (size_t)h->rangeCount * sizeof(float);
+    if (h->magic != scanPacketMagic || h->headerSize < sizeof(ScanPacketHeader) || total > slot.data.size()) {
+        //lost framing, start over with a fresh connection
+        malformedCount++;
+        closeSocket(clientSocket);
+        clientSocket = -1;
+        return false;
+    }
+    if (readExact(buffer + sizeof(ScanPacketHeader), total - sizeof(ScanPacketHeader)) != 1) {
+        closeSocket(clientSocket);
+        clientSocket = -1;
+        return false;
+    }
+    slot.size = total;
+    return true;
+}
+
+//single consumer: converts the ranges where they lie in the ring, then frees the slot
+bool NetIngest::decodeNext(Header& header, Scan& scan, std::vector<Point2D>& points, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    while (t == h) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        h = head.load(std::memory_order_acquire);
+    }
+
+    //live use only cares about the newest scan
+    if (config.latestOnly && h - t > 1) {
+        staleCount += h - t - 1;
+        t = h - 1;
+    }
+
+    const PacketSlot& slot = slots[t % slots.size()];
+    const float* ranges;
+    size_t count;
+    decodeScanPacket(slot.data.data(), slot.size, header, scan, ranges, count);
+    points.resize(count);
+    points.resize(convertToCarterisan(ranges, count, scan, points.data()));
+
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+NetSender::~NetSender() {
+    close();
+}
+
+bool NetSender::open(IngestProtocol protocol, const std::string& host, unsigned short port) {
+    if (!initSockets()) return false;
+    this->protocol = protocol;
+    bool udp = protocol == IngestProtocol::Udp;
+    socketHandle = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (socketHandle < 0) return false;
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+        connect((int)socketHandle, (sockaddr*)&address, sizeof(address)) != 0) {
+        close();
+        return false;
+    }
+    if (!udp) {
+        int yes = 1;
+        setsockopt((int)socketHandle, IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+    }
+    return true;
+}
+
+bool NetSender::send(const std::vector<char>& packet) {
+    size_t done = 0;
+    while (done < packet.size()) {
+        int n = ::send((int)socketHandle, packet.data() + done, (int)(packet.size() - done), 0);
+        if (n <= 0) return false;
+        done += n;
+        if (protocol == IngestProtocol::Udp) break; //a datagram goes out whole or not at all
+    }
+    return done == packet.size();
+}
+
+void NetSender::close() {
+    closeSocket(socketHandle);
+    socketHandle = -1;
+}
@@ -0,0 +1,236 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIDAR_SSE2
+#endif
+
+#include "occupancy_grid.h"
+#include "instrument.h"
+
+//log-odds are stored in hundredths
+static const double logOddsScale = 100.0;
+//ray positions are 16.16 fixed point cell coordinates, relative to the sensor's cell
+static const int fixedShift = 16;
+static const double fixedOne = 65536.0;
+
+static std::uint64_t tileHash(int tx, int ty) {
+    return ((std::uint64_t)(std::uint32_t)tx << 32) | (std::uint32_t)ty;
+}
+
+static std::int16_t toStored(double logOdds) {
+    return (std::int16_t)std::lround(logOdds * logOddsScale);
+}
+
+//grey for unknown as map viewers expect, then darker the more certain a cell is occupied
+static std::uint8_t cellShade(std::int16_t value) {
+    if (value == 0) return 205;
+    double p = 1.0 - 1.0 / (1.0 + std::exp(value / logOddsScale));
+    return (std::uint8_t)std::lround((1.0 - p) * 255.0);
+}
+
+OccupancyGrid::OccupancyGrid(const OccupancyConfig& config)
+    : config(config),
+      hitDelta(toStored(config.hit)), missDelta(toStored(config.miss)),
+      minValue(toStored(config.minLogOdds)), maxValue(toStored(config.maxLogOdds)) {}
+
+OccupancyTile* OccupancyGrid::tileFor(int tx, int ty) {
+    if (cachedTile && tx == cachedTx && ty == cachedTy) return cachedTile;
+
+    std::unique_ptr<OccupancyTile>& slot = tiles[tileHash(tx, ty)];
+    if (!slot) {
+        slot.reset(new OccupancyTile());
+        slot->key = {tx, ty};
+        std::memset(slot->logOdds, 0, sizeof(slot->logOdds));
+        std::memset(slot->updated, 0, sizeof(slot->updated));
+    }
+    cachedTile = slot.get();
+    cachedTx = tx;
+    cachedTy = ty;
+    return cachedTile;
+}
+
+//each cell changes at most once per frame: the first update wins, so hits applied first are never undone
+inline void OccupancyGrid::updateCell(int cx, int cy, std::int16_t delta) {
+    OccupancyTile* tile = tileFor(cx >> tileShift, cy >> tileShift);
+    int local = ((cy & (tileSize - 1)) << tileShift) | (cx & (tileSize - 1));
+    std::uint8_t bit = (std::uint8_t)(1 << (local & 7));
+    if (tile->updated[local >> 3] & bit) return;
+    tile->updated[local >> 3] |= bit;
+
+    if (!tile->inFrame) {
+        tile->inFrame = true;
+        touched.push_back(tile->key);
+    }
+    if (!tile->dirty) {
+        tile->dirty = true;
+        dirty.push_back(tile->key);
+    }
+    int value = tile->logOdds[local] + delta;
+    tile->logOdds[local] = (std::int16_t)std::min<int>(std::max<int>(value, minValue), maxValue);
+}
+
+/*
+- Casts every beam from the sensor's cell to its end cell
+- The end cells get a hit first, then the cells in between get a miss. Rays are walked along their
+- longer axis one cell per step, in 16.16 fixed point relative to the sensor, four rays at a time
+- with SSE2; the cell updates themselves stay scalar since every lane lands in a different place.
+*/
+void OccupancyGrid::integrate(const Pose2D& pose, const Point2D* points, size_t count) {
+    LIDAR_SCOPE("occupancy");
+    touched.clear();
+    cachedTile = nullptr;
+
+    double inv = 1.0 / config.resolution;
+    double c = std::cos(pose.yaw), s = std::sin(pose.yaw);
+    double ox = pose.x * inv, oy = pose.y * inv;        //sensor in cell units
+    int ocx = (int)std::floor(ox), ocy = (int)std::floor(oy);
+    double fracX = ox - ocx, fracY = oy - ocy;
+
+    //end cells and hits
+    stepX.resize(count);
+    stepY.resize(count);
+    steps.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        double x = (c * points[i].x - s * points[i].y) * inv + ox;
+        double y = (s * points[i].x + c * points[i].y) * inv + oy;
+        updateCell((int)std::floor(x), (int)std::floor(y), hitDelta);
+
+        //steps along the longer axis, each one cell long on that axis
+        double dx = x - ox, dy = y - oy;
+        int n = (int)std::ceil(std::max(std::fabs(dx), std::fabs(dy)));
+        steps[i] = n;
+        stepX[i] = n > 0 ? (int)std::lround(dx / n * fixedOne) : 0;
+        stepY[i] = n > 0 ? (int)std::lround(dy / n * fixedOne) : 0;
+    }
+
+    int startX = (int)(fracX * fixedOne), startY = (int)(fracY * fixedOne);
+    size_t i = 0;
+#ifdef LIDAR_SSE2
+    alignas(16) int cellX[4], cellY[4], live[4];
+    __m128i originX = _mm_set1_epi32(ocx), originY = _mm_set1_epi32(ocy);
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_set1_epi32(startX), py = _mm_set1_epi32(startY);
+        __m128i sx = _mm_loadu_si128((const __m128i*)&stepX[i]);
+        __m128i sy = _mm_loadu_si128((const __m128i*)&stepY[i]);
+        __m128i n = _mm_loadu_si128((const __m128i*)&steps[i]);
+        int longest = std::max(std::max(steps[i], steps[i + 1]), std::max(steps[i + 2], steps[i + 3]));
+
+        //step k is still a miss for lanes with more than k steps; the last step is the end cell
+        for (int k = 0; k < longest; k++) {
+            __m128i active = _mm_cmpgt_epi32(n, _mm_set1_epi32(k));
+            _mm_store_si128((__m128i*)cellX, _mm_add_epi32(_mm_srai_epi32(px, fixedShift), originX));
+            _mm_store_si128((__m128i*)cellY, _mm_add_epi32(_mm_srai_epi32(py, fixedShift), originY));
+            _mm_store_si128((__m128i*)live, active);
+            for (int lane = 0; lane < 4; lane++)
+                if (live[lane]) updateCell(cellX[lane], cellY[lane], missDelta);
+            px = _mm_add_epi32(px, sx);
+            py = _mm_add_epi32(py, sy);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        int px = startX, py = startY;
+        for (int k = 0; k < steps[i]; k++) {
+            updateCell(ocx + (px >> fixedShift), ocy + (py >> fixedShift), missDelta);
+            px += stepX[i];
+            py += stepY[i];
+        }
+    }
+
+    //the next frame starts with every cell free to change again
+    for (const TileKey& key : touched) {
+        OccupancyTile* tile = tiles[tileHash(key.tx, key.ty)].get();
+        std::memset(tile->updated, 0, sizeof(tile->updated));
+        tile->inFrame = false;
+    }
+    cachedTile = nullptr;
+}
+
+double OccupancyGrid::logOdds(double x, double y) const {
+    int cx = (int)std::floor(x / config.resolution), cy = (int)std::floor(y / config.resolution);
+    const OccupancyTile* t = tile({cx >> tileShift, cy >> tileShift});
+    if (!t) return 0;
+    return t->logOdds[((cy & (tileSize - 1)) << tileShift) | (cx & (tileSize - 1))] / logOddsScale;
+}
+
+const OccupancyTile* OccupancyGrid::tile(TileKey key) const {
+    auto it = tiles.find(tileHash(key.tx, key.ty));
+    return it == tiles.end() ? nullptr : it->second.get();
+}
+
+std::vector<TileKey> OccupancyGrid::takeDirtyTiles() {
+    std::vector<TileKey> taken;
+    taken.swap(dirty);
+    for (const TileKey& key : taken) tiles[tileHash(key.tx, key.ty)]->dirty = false;
+    return taken;
+}
+
+bool OccupancyGrid::tileBounds(TileKey& min, TileKey& max) const {
+    if (tiles.empty()) return false;
+    min = max = tiles.begin()->second->key;
+    for (const auto& entry : tiles) {
+        const TileKey& key = entry.second->key;
+        min.tx = std::min(min.tx, key.tx);
+        min.ty = std::min(min.ty, key.ty);
+        max.tx = std::max(max.tx, key.tx);
+        max.ty = std::max(max.ty, key.ty);
+    }
+    return true;
+}
+
+//binary PGM, rows from the top; the map's y axis points up so rows are written in reverse
+static bool writePgm(const std::string& filename, int width, int height, const std::vector<std::uint8_t>& pixels) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Could not create " << filename << std::endl;
+        return false;
+    }
+    file << "P5\n" << width << " " << height << "\n255\n";
+    file.write((const char*)pixels.data(), pixels.size());
+    return file.good();
+}
+
+bool writeTilePgm(const OccupancyTile& tile, const std::string& filename) {
+    std::vector<std::uint8_t> pixels(tileCells);
+    for (int y = 0; y < tileSize; y++)
+        for (int x = 0; x < tileSize; x++)
+            pixels[(tileSize - 1 - y) * tileSize + x] = cellShade(tile.logOdds[(y << tileShift) | x]);
+    return writePgm(filename, tileSize, tileSize, pixels);
+}
+
+bool writeMapPgm(const OccupancyGrid& grid, const std::string& filename) {
+    TileKey min, max;
+    if (!grid.tileBounds(min, max)) return false;
+    int width = (max.tx - min.tx + 1) * tileSize, height = (max.ty - min.ty + 1) * tileSize;
+    std::vector<std::uint8_t> pixels((size_t)width * height, cellShade(0));
+
+    for (int ty = min.ty; ty <= max.ty; ty++) {
+        for (int tx = min.tx; tx <= max.tx; tx++) {
+            const OccupancyTile* tile = grid.tile({tx, ty});
+            if (!tile) continue;
+            for (int y = 0; y < tileSize; y++) {
+                int row = height - 1 - ((ty - min.ty) * tileSize + y);
+                std::uint8_t* out = &pixels[(size_t)row * width + (tx - min.tx) * tileSize];
+                for (int x = 0; x < tileSize; x++) out[x] = cellShade(tile->logOdds[(y << tileShift) | x]);
+            }
+        }
+    }
+    return writePgm(filename, width, height, pixels);
+}
+
+int exportDirtyTiles(OccupancyGrid& grid, const std::string& directory) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    int written = 0;
+    for (const TileKey& key : grid.takeDirtyTiles()) {
+        std::string name = directory + "/tile_" + std::to_string(key.tx) + "_" + std::to_string(key.ty) + ".pgm";
+        if (writeTilePgm(*grid.tile(key), name)) written++;
+    }
+    return written;
+}
@@ -2,11 +2,13 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include <random>
+#include <chrono>
 
-#include "file_read.h"
 #include "operations.h"
-#include "constants.h"
+#include "lidar_types.h"
+#include "instrument.h"
 
 //finds the distance
 double distanceToOrigin(const Point2D& p) {
@@ -28,10 +30,28 @@ double distancePointToLine(const Point2D& p, const Line& line) {
 //using angles and distance from the origin where robot lies, finds the exact coordinates
 //x=line.cosx, y=line.siny
 std::vector<Point2D> convertToCarterisan(const std::vector<double>& ranges, const Scan& params) {
-    std::vector<Point2D> points;
+    std::vector<Point2D> points(ranges.size());
+    points.resize(convertToCarterisan(ranges.data(), ranges.size(), params, points.data()));
+    double minX=1e9, maxX=-1e9, minY=1e9, maxY=-1e9;
+    for (auto& p : points) {
+        minX = std::min(minX, p.x);
+        maxX = std::max(maxX, p.x);
+        minY = std::min(minY, p.y);
+        maxY = std::max(maxY, p.y);
+    }
+    std::cout << "Point range X: " << minX << " to " << maxX << " Y: " << minY << " to " << maxY << std::endl;
+    return points;
+}   
+
+//same conversion straight from a caller's buffer into a caller's buffer, nothing is allocated or copied
+//points must have room for count entries, returns how many points were in range
+template <typename T>
+static size_t convertRanges(const T* ranges, size_t count, const Scan& params, Point2D* points) {
+    LIDAR_SCOPE("convert");
+    size_t written = 0;
 
     //find each point's, whose range we know, coordinates
-    for (int i=0; i<ranges.size(); i++) {
+    for (size_t i=0; i<count; i++) {
         double range = ranges[i];
 
         //Filter out dots that are not in our range
@@ -42,22 +62,21 @@ std::vector<Point2D> convertToCarterisan(const std::vector<double>& ranges, cons
         double angle = params.angle_min + i*params.angle_increment;
 
         //convert to xy coordinates through trigonometry
-        Point2D point;
-        point.x = range * std::cos(angle);
-        point.y = range * std::sin(angle);
-
-        points.push_back(point);
+        points[written].x = range * std::cos(angle);
+        points[written].y = range * std::sin(angle);
+        written++;
     }
-    double minX=1e9, maxX=-1e9, minY=1e9, maxY=-1e9;
-    for (auto& p : points) {
-        minX = std::min(minX, p.x);
-        maxX = std::max(maxX, p.x);
-        minY = std::min(minY, p.y);
-        maxY = std::max(maxY, p.y);
-    }
-    std::cout << "Point range X: " << minX << " to " << maxX << " Y: " << minY << " to " << maxY << std::endl;
-    return points;
-}   
+    return written;
+}
+
+size_t convertToCarterisan(const double* ranges, size_t count, const Scan& params, Point2D* points) {
+    return convertRanges(ranges, count, params, points);
+}
+
+//drivers often hand out single precision ranges
+size_t convertToCarterisan(const float* ranges, size_t count, const Scan& params, Point2D* points) {
+    return convertRanges(ranges, count, params, points);
+}
 
 //creating a line from points
 Line createLineFromPoints(const Point2D& point1, const Point2D& point2) {
@@ -163,6 +182,8 @@ std::vector<int> findInliers(const std::vector<Point2D>& points,
                             const std::vector<int>& availableIndices, 
                             const Line& line,
                             double threshold, double maxGap) {
+    LIDAR_COUNT(CounterCandidates, 1);
+    LIDAR_COUNT(CounterInliersTested, availableIndices.size());
     std::vector<int> inliers;
     for (int idx : availableIndices) {
         if (distancePointToLine(points[idx], line) < threshold) {
@@ -192,12 +213,70 @@ std::vector<int> findInliers(const std::vector<Point2D>& points,
     return filteredInliers;
 }
 
+//share of first points on a line whose neighbour within window, as Local draws it, is on the line too
+//positions are the line's points in the sampled order, ascending
+static double localShare(const std::vector<int>& positions, int window) {
+    if (positions.size() < 2) return 0;
+    size_t pairs = 0, lo = 0, hi = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        while (positions[lo] < positions[i] - window) lo++;
+        while (hi + 1 < positions.size() && positions[hi + 1] <= positions[i] + window) hi++;
+        pairs += hi - lo;
+    }
+    return (double)pairs / (positions.size() * 2.0 * window);
+}
+
+//least squares line through the given points, the direction the points spread most along
+static Line fitLineToPoints(const std::vector<Point2D>& points, const std::vector<int>& indices) {
+    double cx = 0, cy = 0;
+    for (int idx : indices) {
+        cx += points[idx].x;
+        cy += points[idx].y;
+    }
+    cx /= indices.size();
+    cy /= indices.size();
+    double sxx = 0, syy = 0, sxy = 0;
+    for (int idx : indices) {
+        double dx = points[idx].x - cx, dy = points[idx].y - cy;
+        sxx += dx * dx;
+        syy += dy * dy;
+        sxy += dx * dy;
+    }
+    //the normal is perpendicular to the main axis of the spread
+    double angle = 0.5 * std::atan2(2 * sxy, sxx - syy);
+    Line line;
+    line.a = -std::sin(angle);
+    line.b = std::cos(angle);
+    line.c = -(line.a * cx + line.b * cy);
+
+    //same sign convention as createLineFromPoints, c is never negative
+    if (line.c < 0) {
+        line.a = -line.a;
+        line.b = -line.b;
+        line.c = -line.c;
+    }
+    return line;
+}
+
 //ransac algorithm
 Line findBestLineRANSAC(const std::vector<Point2D>& points,
                         const std::vector<int>& availableIndices,
                         std::vector<int>& bestInliers,
                         const RANSACparameters& config,
                         std::mt19937& gen) {
+    RANSACstats stats;
+    return findBestLineRANSAC(points, availableIndices, bestInliers, config, gen, Deadline::max(), stats);
+}
+
+//ransac algorithm with a wall-clock deadline, returns the best line found until the deadline
+//or until another thread sets cancel
+Line findBestLineRANSAC(const std::vector<Point2D>& points,
+                        const std::vector<int>& availableIndices,
+                        std::vector<int>& bestInliers,
+                        const RANSACparameters& config,
+                        std::mt19937& gen,
+                        Deadline deadline, RANSACstats& stats,
+                        const std::atomic<bool>* cancel) {
     /*
     - RANSAC (Random Sample Consensus) Algorithm:
     - Randomly select 2 points
@@ -205,27 +284,161 @@ Line findBestLineRANSAC(const std::vector<Point2D>& points,
     - Count how many other points fit this line (inliers)
     - Repeat many times
     - Keep the line with most inliers (best fit)
+    - If the deadline passes, stop sampling and keep what we have (anytime behaviour)
+    -
+    - Most candidates run through two random points on different walls and fit almost nothing.
+    - With earlyRejection each candidate first goes through a sequential probability ratio test
+    - (Wald's SPRT, as in Matas and Chum's randomized RANSAC): points are checked in random order and
+    - every miss makes "this is a bad line" more likely. Once that is likely enough the candidate is
+    - dropped, usually after a dozen points or so. What the test lets through has seen every point,
+    - so its raw count is known, and only a count above the best so far is scored in full.
+    -
+    - Drawing both points anywhere mostly pairs two walls. Local sampling takes the second point from
+    - the scan neighbours of the first, which on a scan of many short walls are usually on the same
+    - one.
+    -
+    - With a confidence the search stops after N = log(1 - confidence) / log(1 - P) iterations, the
+    - usual RANSAC bound. P is the chance that one sample draws two points of the best line: its share of
+    - the points squared when both are drawn anywhere, its share times the share of neighbours on it
+    - when the second is a neighbour. Until a line is found, a run of minPoints points stands in for it,
+    - so a search that finds nothing gives up too. Local sampling raises P most for short lines, and that
+    - is where the bound comes out smaller. Stopping that soon leaves a line through two points only a few
+    - centimetres apart, so the line is then fitted to its inliers by least squares and scored again.
     */
+    LIDAR_SCOPE("ransac");
 
     Line bestLine;      //best line found will be stored
     bestInliers.clear(); //clearing the output parameter
     
     //random number generator for selecting points
     std::uniform_int_distribution<> dis(0, availableIndices.size() - 1);
+    size_t n = availableIndices.size();
+    int window = std::max(1, std::min(config.sampleWindow, (int)n - 1));
+    std::uniform_int_distribution<> step(1, window);
+    //when each improvement of the best candidate came, to tell when the line was found at all
+    std::vector<std::pair<int, size_t>> improvements;
+
+    //iterations after which a line as good as the best would have come up with the given confidence
+    //a good line that the test below drops is not found by that sample, so it counts as a miss
+    double survive = config.earlyRejection ? 0.95 : 1.0;
+    auto iterationsNeeded = [&](const std::vector<int>& positions) {
+        double share = (double)positions.size() / n;
+        double success = survive * share * (config.sampling == SamplingMode::Uniform ? share : localShare(positions, window));
+        if (success >= 1) return 1.0;
+        if (success <= 0) return (double)config.maxIterations;
+        return std::log(1 - config.confidence) / std::log(1 - success);
+    };
+    double stopAfter = config.maxIterations;
+    std::vector<int> positions;
+    if (config.confidence > 0) {
+        for (int i = 0; i < config.minPoints; i++) positions.push_back(i);
+        stopAfter = std::min(stopAfter, iterationsNeeded(positions));
+    }
+
+    //points in random order for the test, each candidate starts reading it somewhere else; the scan
+    //order would show a candidate one wall at a time
+    std::vector<int> order;
+    if (config.earlyRejection) {
+        order = availableIndices;
+        std::shuffle(order.begin(), order.end(), gen);
+    }
+
+    //epsilon: share of points on a line worth having, the smallest acceptable line until one is found,
+    //then the best one so far since nothing smaller can win anyway
+    //delta: share of points a bad line happens to pass near, measured from the candidates as they come
+    double epsilon = (double)config.minPoints / n;
+    double delta = 0.01;
+    double deltaSum = 0;
+    int deltaSamples = 0;
+    //log of the likelihood ratio at which a candidate is dropped; a good line survives with probability
+    //of about 1 - 1/exp(rejectLog), a lost line is found again by a later candidate
+    const double rejectLog = std::log(20.0);
+    double hitLog = 0, missLog = 0;
+    auto updateTest = [&] {
+        hitLog = std::log(delta / epsilon);
+        missLog = std::log((1 - delta) / (1 - epsilon));
+    };
+    updateTest();
     
     //trying random samples (Monte Carlo approach)
-    for (int iter = 0; iter < config.maxIterations; ++iter) {
+    for (int iter = 0; iter < config.maxIterations && iter < stopAfter; ++iter) {
+        //reading the clock is cheap next to scoring a candidate, so we check it every iteration
+        if (std::chrono::steady_clock::now() >= deadline) {
+            stats.partial = true;
+            break;
+        }
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            stats.partial = true;
+            stats.cancelled = true;
+            break;
+        }
+        stats.iterations++;
+        LIDAR_COUNT(CounterIterations, 1);
+
         // Randomly select 2 different points
-        int idx1 = availableIndices[dis(gen)];
-        int idx2 = availableIndices[dis(gen)];
+        int idx1, idx2;
+        if (config.sampling == SamplingMode::Uniform) {
+            idx1 = availableIndices[dis(gen)];
+            idx2 = availableIndices[dis(gen)];
+        } else {
+            int first = dis(gen);
+            //a neighbour on either side, mirrored back when that side runs out of points
+            int offset = (gen() & 1) ? step(gen) : -step(gen);
+            int second = first + offset;
+            if (second < 0 || second >= (int)n) second = first - offset;
+            second = std::max(0, std::min(second, (int)n - 1));
+            idx1 = availableIndices[first];
+            idx2 = availableIndices[second];
+        }
         
         //skipping if we got the same point twice
         if (idx1 == idx2) continue;
         
         //creating a candidate line through these two points
         Line candidateLine = createLineFromPoints(points[idx1], points[idx2]);
+
+        //the test only pays off while a bad line is clearly less likely to pass near a point than a good one
+        if (config.earlyRejection && delta < epsilon) {
+            size_t offset = dis(gen);
+            size_t tested = 0, hits = 0;
+            double ratio = 0;
+            bool rejected = false;
+            for (; tested < n; tested++) {
+                size_t k = offset + tested;
+                if (k >= n) k -= n;
+                if (distancePointToLine(points[order[k]], candidateLine) < config.distanceThreshold) {
+                    hits++;
+                    ratio += hitLog;
+                } else {
+                    ratio += missLog;
+                    if (ratio > rejectLog) {
+                        tested++;
+                        rejected = true;
+                        break;
+                    }
+                }
+            }
+            stats.pointsTested += tested;
+            LIDAR_COUNT(CounterInliersTested, tested);
+
+            deltaSum += (double)hits / tested;
+            deltaSamples++;
+            if ((deltaSamples & 15) == 0) {
+                delta = std::max(deltaSum / deltaSamples, 1e-4);
+                updateTest();
+            }
+            if (rejected) {
+                stats.rejectedEarly++;
+                LIDAR_COUNT(CounterRejectedEarly, 1);
+                continue;
+            }
+            //the gap filter in findInliers only ever removes points
+            if (hits <= bestInliers.size()) continue;
+        }
         
         //finding all points that fit this line (inliers)
+        stats.candidatesScored++;
+        stats.pointsTested += n;
         std::vector<int> inliers = findInliers(points, availableIndices, 
                                                candidateLine, config.distanceThreshold, 0.5);
         
@@ -233,6 +446,40 @@ Line findBestLineRANSAC(const std::vector<Point2D>& points,
         if (inliers.size() > bestInliers.size()) {
             bestInliers = inliers;    //updating best inliers
             bestLine = candidateLine;  //updating best line
+            improvements.push_back({iter + 1, inliers.size()});
+            if (config.confidence > 0 && inliers.size() >= (size_t)config.minPoints) {
+                //availableIndices is sorted, so the inliers' places in it come out ascending
+                positions.clear();
+                for (int idx : inliers)
+                    positions.push_back(std::lower_bound(availableIndices.begin(), availableIndices.end(), idx)
+                                        - availableIndices.begin());
+                stopAfter = iterationsNeeded(positions);
+            }
+            if ((double)inliers.size() / n > epsilon) {
+                epsilon = std::min((double)inliers.size() / n, 0.99);
+                updateTest();
+            }
+        }
+    }
+    if (config.confidence > 0 && !stats.cancelled) {
+        for (int round = 0; round < 3 && bestInliers.size() >= (size_t)config.minPoints; round++) {
+            Line fitted = fitLineToPoints(points, bestInliers);
+            std::vector<int> inliers = findInliers(points, availableIndices, fitted, config.distanceThreshold, 0.5);
+            stats.candidatesScored++;
+            stats.pointsTested += n;
+            if (inliers.size() <= bestInliers.size()) break;
+            bestInliers = inliers;
+            bestLine = fitted;
+        }
+    }
+
+    //the last improvements only add a point here and there, 90% of the final count is the line found
+    if (bestInliers.size() >= (size_t)config.minPoints) {
+        for (const auto& improvement : improvements) {
+            if (improvement.second * 10 >= bestInliers.size() * 9) {
+                stats.iterationsToFind += improvement.first;
+                break;
+            }
         }
     }
     
@@ -242,7 +489,31 @@ Line findBestLineRANSAC(const std::vector<Point2D>& points,
 //detect lines
 std::vector<Line> detectLines(const std::vector<Point2D>& points, 
                               const RANSACparameters& config) {
-    std::vector<Line> detectedLines;              // Output: all lines found
+    RANSACstats stats;
+    return detectLines(points, config, Deadline::max(), stats);
+}
+
+std::vector<Line> detectLines(const std::vector<Point2D>& points, 
+                              const RANSACparameters& config,
+                              Deadline deadline, RANSACstats& stats,
+                              const std::atomic<bool>* cancel) {
+    std::vector<Line> detectedLines;
+    detectLines(points, config, deadline, stats, detectedLines, cancel);
+    return detectedLines;
+}
+
+//detect lines until running out of points or time, whichever comes first
+void detectLines(const std::vector<Point2D>& points,
+                 const RANSACparameters& config,
+                 Deadline deadline, RANSACstats& stats,
+                 std::vector<Line>& detectedLines,
+                 const std::atomic<bool>* cancel) {
+    LIDAR_SCOPE("detectLines");
+    auto startTime = std::chrono::steady_clock::now();
+    stats = RANSACstats();
+
+    //lines left from the caller's last frame are overwritten in place, so their index vectors are reused
+    size_t found = 0;
     std::vector<bool> used(points.size(), false); // Track which points are assigned
     
     // Random number generator (seeded from hardware)
@@ -253,34 +524,53 @@ std::vector<Line> detectLines(const std::vector<Point2D>& points,
     while (true) {
         //get list of points not assigned to any line
         std::vector<int> availableIndices = getAvailableIndices(used);
+        stats.pointsRemaining = availableIndices.size();
         
         //stop if not enough points remain for a valid line
         if (availableIndices.size() < config.minPoints) {
             break;
         }
+
+        //out of time, whatever we have found so far is the result
+        if (std::chrono::steady_clock::now() >= deadline) {
+            stats.partial = true;
+            break;
+        }
         
         //find the best line in remaining points
         std::vector<int> bestInliers;
         Line bestLine = findBestLineRANSAC(points, availableIndices, 
-                                          bestInliers, config, gen);
+                                          bestInliers, config, gen, deadline, stats, cancel);
         
         //check if we found a valid line (enough inliers)
+        //a search cut short by the deadline still gives a usable line if it has enough points
         if (bestInliers.size() >= config.minPoints) {
             // Store the line with its inlier points
-            bestLine.pointIndices = bestInliers;
-            detectedLines.push_back(bestLine);
+            if (found == detectedLines.size()) detectedLines.emplace_back();
+            Line& line = detectedLines[found++];
+            line.a = bestLine.a;
+            line.b = bestLine.b;
+            line.c = bestLine.c;
+            line.pointIndices.assign(bestInliers.begin(), bestInliers.end());
             
             //mark these points as used so we don't use them again
             for (int idx : bestInliers) {
                 used[idx] = true;
             }
+            stats.pointsRemaining -= bestInliers.size();
         } else {
             //no more valid lines can be found
             break;
         }
+
+        if (stats.partial) break;
     }
-    
-    return detectedLines;
+    //a cancelled search is thrown away by the caller, partial lines would only mislead
+    if (stats.cancelled) found = 0;
+    detectedLines.resize(found);
+
+    stats.linesFound = detectedLines.size();
+    stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
 }
 
 //classic intersection test using linear algebra
@@ -327,6 +617,14 @@ bool isOnSegment(const Line& line1, const Line& line2, const std::vector<Point2D
 std::vector<Intersection> findValidIntersections(const std::vector<Line>& lines, 
                         const std::vector<Point2D>& points, double minAngleThreshold) {
     std::vector<Intersection> validIntersections;
+    findValidIntersections(lines, points, minAngleThreshold, validIntersections);
+    return validIntersections;
+}
+
+void findValidIntersections(const std::vector<Line>& lines, const std::vector<Point2D>& points,
+                            double minAngleThreshold, std::vector<Intersection>& validIntersections) {
+    LIDAR_SCOPE("intersections");
+    validIntersections.clear();
 
     //checking every pair of lines (combinatorial: n choose 2)
     for (size_t i = 0; i < lines.size(); ++i) {
@@ -359,5 +657,4 @@ std::vector<Intersection> findValidIntersections(const std::vector<Line>& lines,
             }
         }
     }
-    return validIntersections;
 }
\ No newline at end of file
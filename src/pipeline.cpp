@@ -0,0 +1,297 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+
+#include "file_read.h"
+#include "operations.h"
+#include "pipeline.h"
+#include "instrument.h"
+
+//reads every part of a single scan file
+bool readFrame(const std::string& filename, RawFrame& frame) {
+    LIDAR_SCOPE("parse");
+    frame.header = readHeader(filename);
+    frame.scan = readScan(filename);
+    frame.ranges = readRanges(filename);
+    frame.intensities = readIntensities(filename);
+
+    //readRanges gives back the error vector if the file could not be opened
+    std::vector<double> errorVector = ERROR_VECTOR;
+    return frame.ranges != errorVector;
+}
+
+//gives a new frame every time the file changes on disk, the first call always reads it
+FrameSource watchTomlFile(const std::string& filename) {
+    auto lastWrite = std::make_shared<std::filesystem::file_time_type>();
+    auto first = std::make_shared<bool>(true);
+
+    return [filename, lastWrite, first](RawFrame& frame) {
+        std::error_code error;
+        std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(filename, error);
+        if (error) return false;
+        if (!*first && writeTime == *lastWrite) return false;
+
+        *first = false;
+        *lastWrite = writeTime;
+        return readFrame(filename, frame);
+    };
+}
+
+//whole processing chain for one scan: polar to cartesian, line detection, intersections, spatial index for drawing
+void processFrame(const RawFrame& raw, const PipelineConfig& config, FrameResult& result) {
+    result.header = raw.header;
+    result.scan = raw.scan;
+    //converted into the result's own buffer, a reused FrameResult does not allocate here
+    result.points.resize(raw.ranges.size());
+    result.points.resize(convertToCarterisan(raw.ranges.data(), raw.ranges.size(), raw.scan, result.points.data()));
+    processPoints(config, result);
+}
+
+//same chain for a compact frame, decoded and converted in one pass
+void processQuantizedFrame(const QuantizedFrame& frame, const PipelineConfig& config, FrameResult& result) {
+    result.header = frame.header;
+    result.scan = frame.scan;
+    result.points.resize(frame.ranges.size());
+    result.points.resize(convertQuantized(frame.ranges.data(), frame.ranges.size(), frame.rangeScale,
+                                          frame.scan, result.points.data()));
+    processPoints(config, result);
+}
+
+//everything after conversion, for frames whose points are already in result
+void processPoints(const PipelineConfig& config, FrameResult& result) {
+    result.config = config;
+
+    Deadline deadline = Deadline::max();
+    if (config.detectionBudgetMs > 0)
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.detectionBudgetMs);
+    detectLines(result.points, config.ransac, deadline, result.stats, result.lines);
+    findValidIntersections(result.lines, result.points, config.minAngleThreshold, result.intersections);
+    buildDisplayTrees(config, result);
+}
+
+void buildDisplayTrees(const PipelineConfig& config, FrameResult& result) {
+    if (!config.buildTrees) {
+        //a reused result must not keep the trees of an earlier frame
+        result.tree.nodes.clear();
+        result.lineTree.nodes.clear();
+        return;
+    }
+    buildQuadTree(result.tree, result.points);
+    buildQuadTree(result.lineTree, result.points, result.lines);
+}
+
+bool sameDetectionSettings(const PipelineConfig& a, const PipelineConfig& b) {
+    return a.ransac.minPoints == b.ransac.minPoints
+        && a.ransac.distanceThreshold == b.ransac.distanceThreshold
+        && a.ransac.maxIterations == b.ransac.maxIterations
+        && a.ransac.earlyRejection == b.ransac.earlyRejection
+        && a.ransac.sampling == b.ransac.sampling
+        && a.ransac.sampleWindow == b.ransac.sampleWindow
+        && a.ransac.confidence == b.ransac.confidence
+        && a.detectionBudgetMs == b.detectionBudgetMs;
+}
+
+bool sameSettings(const PipelineConfig& a, const PipelineConfig& b) {
+    return sameDetectionSettings(a, b) && a.minAngleThreshold == b.minAngleThreshold;
+}
+
+ProcessingWorker::ProcessingWorker(FrameSource source, const PipelineConfig& config)
+    : source(source), config(config) {}
+
+ProcessingWorker::ProcessingWorker(PointSource pointSource, const PipelineConfig& config)
+    : pointSource(pointSource), config(config) {}
+
+ProcessingWorker::~ProcessingWorker() {
+    stop();
+}
+
+void ProcessingWorker::start() {
+    if (running) return;
+    running = true;
+    thread = std::thread(&ProcessingWorker::run, this);
+}
+
+void ProcessingWorker::stop() {
+    running = false;
+    if (thread.joinable()) thread.join();
+}
+
+void ProcessingWorker::setConfig(const PipelineConfig& config) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    this->config = config;
+}
+
+bool ProcessingWorker::update() {
+    return results.update();
+}
+
+const FrameResult& ProcessingWorker::latest() const {
+    return results.readBuffer();
+}
+
+FrameResult& ProcessingWorker::latest() {
+    return results.readBuffer();
+}
+
+//producer loop: pull a frame, process it straight into the write buffer, publish it
+void ProcessingWorker::run() {
+    RawFrame raw;
+    while (running) {
+        //settings can change between frames, never during one
+        PipelineConfig frameConfig;
+        {
+            std::lock_guard<std::mutex> lock(configMutex);
+            frameConfig = config;
+        }
+
+        if (pointSource) {
+            //points land directly in the write buffer, it is only published once processed
+            FrameResult& result = results.writeBuffer();
+            if (!pointSource(result.header, result.scan, result.points)) continue;
+            processPoints(frameConfig, result);
+            track(result);
+            result.sequence = ++sequence;
+            results.publish();
+            continue;
+        }
+
+        if (!source(raw)) {
+            //nothing new, do not spin on the source
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+
+        FrameResult& result = results.writeBuffer();
+        processFrame(raw, frameConfig, result);
+        track(result);
+        result.sequence = ++sequence;
+        results.publish();
+    }
+}
+
+void ProcessingWorker::track(FrameResult& result) {
+    result.motion = odometry.addScan(result.points, result.lines);
+    result.pose = odometry.pose();
+    //a failed match leaves the pose where the last frame was, its corners would land in the wrong place
+    if (result.motion.valid) landmarks.addObservations(result.pose, result.intersections, sequence + 1, result.landmarkIds);
+    else result.landmarkIds.assign(result.intersections.size(), -1);
+    result.landmarkCount = landmarks.size();
+}
+
+RetuneWorker::~RetuneWorker() {
+    stop();
+}
+
+void RetuneWorker::start() {
+    if (running) return;
+    running = true;
+    thread = std::thread(&RetuneWorker::run, this);
+}
+
+void RetuneWorker::stop() {
+    cancel();
+    running = false;
+    wake.notify_all();
+    if (thread.joinable()) thread.join();
+}
+
+void RetuneWorker::request(std::shared_ptr<const FrameResult> frame, const PipelineConfig& config, bool redetect) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingRedetect = redetect;
+        pendingFrame = std::move(frame);
+        pendingConfig = config;
+        pending = true;
+        generation++;
+        cancelled = true;
+    }
+    wake.notify_one();
+}
+
+void RetuneWorker::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = false;
+    pendingFrame.reset();
+    generation++;
+    cancelled = true;
+}
+
+bool RetuneWorker::update() {
+    return results.update();
+}
+
+const FrameResult& RetuneWorker::latest() const {
+    return results.readBuffer();
+}
+
+void RetuneWorker::run() {
+    while (running) {
+        std::shared_ptr<const FrameResult> source;
+        bool redetect;
+        PipelineConfig config;
+        unsigned long requestGeneration;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return pending || !running; });
+            if (!running) break;
+            source = std::move(pendingFrame);
+            config = pendingConfig;
+            redetect = pendingRedetect;
+            requestGeneration = generation;
+            pending = false;
+            cancelled = false;
+            working = true;
+        }
+
+        //copied on this thread, into a buffer that keeps its memory between requests
+        FrameResult& result = results.writeBuffer();
+        result.header = source->header;
+        result.scan = source->scan;
+        result.points = source->points;
+        result.tree = source->tree;     //the points do not change, only the line tree is built again
+        result.motion = source->motion;
+        result.pose = source->pose;
+        result.landmarkCount = source->landmarkCount;
+        result.sequence = source->sequence;
+
+        //the lines on screen may come from an earlier retune or from a frame that started before the settings
+        //changed; keeping them is only right if they were found with these settings
+        if (!redetect && sameDetectionSettings(source->config, config)) {
+            result.lines = source->lines;
+            result.stats = source->stats;
+        }
+        else if (!redetect && detectedSequence == source->sequence && sameDetectionSettings(detectedConfig, config)) {
+            result.lines = detectedLines;
+            result.stats = detectedStats;
+        }
+        else {
+            Deadline deadline = Deadline::max();
+            if (config.detectionBudgetMs > 0)
+                deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.detectionBudgetMs);
+            detectLines(result.points, config.ransac, deadline, result.stats, result.lines, &cancelled);
+            if (!cancelled) {
+                detectedLines = result.lines;
+                detectedStats = result.stats;
+                detectedConfig = config;
+                detectedSequence = source->sequence;
+            }
+        }
+        source.reset();
+
+        if (!cancelled) {
+            result.config = config;
+            findValidIntersections(result.lines, result.points, config.minAngleThreshold, result.intersections);
+            if (config.buildTrees) buildQuadTree(result.lineTree, result.points, result.lines);
+            else result.lineTree.nodes.clear();
+            //the map only takes frames from the sensor, these corners were not merged into it
+            result.landmarkIds.assign(result.intersections.size(), -1);
+            //checked and published under the lock, so a request that comes in meanwhile always wins
+            std::lock_guard<std::mutex> lock(mutex);
+            if (generation == requestGeneration) results.publish();
+        }
+        working = false;
+    }
+}
@@ -0,0 +1,138 @@
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+#include "quadtree.h"
+#include "instrument.h"
+
+//splits a node into four quarters until it holds few enough points
+static void splitNode(QuadTree& tree, const std::vector<Point2D>& points, int nodeIndex,
+                      int depth, int leafSize, int maxDepth) {
+    //copy, pushing children may move the nodes vector
+    QuadNode node = tree.nodes[nodeIndex];
+    if (node.count <= leafSize || depth >= maxDepth) return;
+
+    double half = node.size / 2;
+    double midX = node.minX + half;
+    double midY = node.minY + half;
+
+    /*
+    - reorder the node's slice of indices in place: bottom half first, then each half by x
+    - the slice ends up as [SW | SE | NW | NE] so every child is contiguous too
+    */
+    auto begin = tree.indices.begin() + node.first;
+    auto end = begin + node.count;
+    auto splitY = std::partition(begin, end, [&](int i) { return points[i].y < midY; });
+    auto splitBottom = std::partition(begin, splitY, [&](int i) { return points[i].x < midX; });
+    auto splitTop = std::partition(splitY, end, [&](int i) { return points[i].x < midX; });
+
+    std::vector<int>::iterator bounds[5] = {begin, splitBottom, splitY, splitTop, end};
+    tree.nodes[nodeIndex].leaf = false;
+    for (int q = 0; q < 4; q++) {
+        int first = bounds[q] - tree.indices.begin();
+        int count = bounds[q + 1] - bounds[q];
+        if (count == 0) continue;
+
+        QuadNode child;
+        child.minX = (q % 2 == 0) ? node.minX : midX;
+        child.minY = (q < 2) ? node.minY : midY;
+        child.size = half;
+        child.first = first;
+        child.count = count;
+        std::fill(child.children, child.children + 4, -1);
+        child.leaf = true;
+
+        tree.nodes.push_back(child);
+        int childIndex = tree.nodes.size() - 1;
+        tree.nodes[nodeIndex].children[q] = childIndex;
+        splitNode(tree, points, childIndex, depth + 1, leafSize, maxDepth);
+    }
+}
+
+//builds the tree over the points in tree.indices, the root is the smallest square around them
+static void buildOverIndices(QuadTree& tree, const std::vector<Point2D>& points, int leafSize, int maxDepth) {
+    tree.nodes.clear();
+    if (tree.indices.empty()) return;
+
+    const Point2D& start = points[tree.indices[0]];
+    double minX = start.x, maxX = start.x, minY = start.y, maxY = start.y;
+    for (int idx : tree.indices) {
+        const Point2D& p = points[idx];
+        minX = std::min(minX, p.x);
+        maxX = std::max(maxX, p.x);
+        minY = std::min(minY, p.y);
+        maxY = std::max(maxY, p.y);
+    }
+
+    QuadNode root;
+    root.minX = minX;
+    root.minY = minY;
+    root.size = std::max(maxX - minX, maxY - minY) + 1e-6; //points on the far edge still fall inside
+    root.first = 0;
+    root.count = tree.indices.size();
+    std::fill(root.children, root.children + 4, -1);
+    root.leaf = true;
+
+    tree.nodes.reserve(2 * tree.indices.size() / std::max(leafSize, 1) + 1);
+    tree.nodes.push_back(root);
+    splitNode(tree, points, 0, 0, leafSize, maxDepth);
+}
+
+void buildQuadTree(QuadTree& tree, const std::vector<Point2D>& points, int leafSize, int maxDepth) {
+    LIDAR_SCOPE("quadtree");
+    tree.indices.resize(points.size());
+    std::iota(tree.indices.begin(), tree.indices.end(), 0);
+    buildOverIndices(tree, points, leafSize, maxDepth);
+}
+
+void buildQuadTree(QuadTree& tree, const std::vector<Point2D>& points, const std::vector<Line>& lines,
+                   int leafSize, int maxDepth) {
+    LIDAR_SCOPE("quadtree");
+    tree.indices.clear();
+    for (const Line& line : lines)
+        tree.indices.insert(tree.indices.end(), line.pointIndices.begin(), line.pointIndices.end());
+    buildOverIndices(tree, points, leafSize, maxDepth);
+}
+
+/*
+- collects what has to be drawn for the visible rectangle
+- nodes outside the rectangle are skipped entirely
+- nodes smaller than minCellSize are returned as one density cell instead of their points,
+- so the output never grows beyond roughly (view size / minCellSize)^2 entries
+*/
+void queryQuadTree(const QuadTree& tree, const std::vector<Point2D>& points,
+                   double minX, double minY, double maxX, double maxY, double minCellSize,
+                   std::vector<int>& visiblePoints, std::vector<DensityCell>& cells) {
+    visiblePoints.clear();
+    cells.clear();
+    if (tree.nodes.empty()) return;
+
+    std::vector<int> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const QuadNode& node = tree.nodes[stack.back()];
+        stack.pop_back();
+
+        //off screen
+        if (node.minX > maxX || node.minX + node.size < minX ||
+            node.minY > maxY || node.minY + node.size < minY) continue;
+
+        //too small to tell its points apart on screen
+        if (node.size <= minCellSize && node.count > 1) {
+            cells.push_back({node.minX, node.minY, node.size, node.count});
+            continue;
+        }
+
+        if (node.leaf) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const Point2D& p = points[tree.indices[i]];
+                if (p.x >= minX && p.x <= maxX && p.y >= minY && p.y <= maxY)
+                    visiblePoints.push_back(tree.indices[i]);
+            }
+            continue;
+        }
+
+        for (int child : node.children)
+            if (child >= 0) stack.push_back(child);
+    }
+}
@@ -0,0 +1,150 @@
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIDAR_SSE2
+#endif
+
+#include "quantized.h"
+
+//the largest value that still fits, 0 is kept for "no return"
+static const double maxQuantized = 65535.0;
+
+void quantizeFrame(const Header& header, const Scan& scan, const std::vector<double>& ranges,
+                   const std::vector<double>& intensities, QuantizedFrame& frame) {
+    frame.header = header;
+    frame.scan = scan;
+    frame.rangeScale = (float)std::max(0.001, scan.range_max / maxQuantized);
+    double scale = frame.rangeScale;
+
+    frame.ranges.resize(ranges.size());
+    for (size_t i = 0; i < ranges.size(); i++) {
+        double range = ranges[i];
+        //out of range, NaN and inf all become "no return", conversion drops them the same way
+        if (!(range >= scan.range_min && range <= scan.range_max)) {
+            frame.ranges[i] = 0;
+            continue;
+        }
+        //rounding must not push a valid range out of [range_min, range_max]
+        double q = std::round(range / scale);
+        if (q * scale > scan.range_max) q -= 1;
+        if (q * scale < scan.range_min) q += 1;
+        frame.ranges[i] = (std::uint16_t)std::min(std::max(q, 1.0), maxQuantized);
+    }
+
+    double maxIntensity = 0;
+    for (double v : intensities) if (v > maxIntensity) maxIntensity = v;
+    frame.intensityScale = maxIntensity > maxQuantized ? (float)(maxIntensity / maxQuantized) : 1.0f;
+    frame.intensities.resize(intensities.size());
+    for (size_t i = 0; i < intensities.size(); i++) {
+        double q = std::round(std::max(intensities[i], 0.0) / frame.intensityScale);
+        frame.intensities[i] = (std::uint16_t)std::min(q, maxQuantized);
+    }
+}
+
+void dequantizeRanges(const QuantizedFrame& frame, std::vector<double>& ranges) {
+    ranges.resize(frame.ranges.size());
+    for (size_t i = 0; i < frame.ranges.size(); i++) ranges[i] = frame.ranges[i] * (double)frame.rangeScale;
+}
+
+void dequantizeIntensities(const QuantizedFrame& frame, std::vector<double>& intensities) {
+    intensities.resize(frame.intensities.size());
+    for (size_t i = 0; i < frame.intensities.size(); i++)
+        intensities[i] = frame.intensities[i] * (double)frame.intensityScale;
+}
+
+//cos and sin of every beam angle; a sensor keeps the same geometry, so this is built once per thread
+struct BeamTable {
+    double angleMin = 0;
+    double increment = 0;
+    std::vector<double> cosines;
+    std::vector<double> sines;
+};
+
+static const BeamTable& beamTable(const Scan& params, size_t count) {
+    thread_local BeamTable table;
+    if (table.angleMin != params.angle_min || table.increment != params.angle_increment || table.cosines.size() < count) {
+        table.angleMin = params.angle_min;
+        table.increment = params.angle_increment;
+        table.cosines.resize(count);
+        table.sines.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            //same angle formula as convertToCarterisan, so both give the same points
+            double angle = params.angle_min + i*params.angle_increment;
+            table.cosines[i] = std::cos(angle);
+            table.sines[i] = std::sin(angle);
+        }
+    }
+    return table;
+}
+
+size_t convertQuantizedScalar(const std::uint16_t* ranges, size_t count, float scale, const Scan& params, Point2D* points) {
+    const BeamTable& table = beamTable(params, count);
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        double range = ranges[i] * (double)scale;
+        if (range < params.range_min || range > params.range_max) continue;
+        points[written].x = range * table.cosines[i];
+        points[written].y = range * table.sines[i];
+        written++;
+    }
+    return written;
+}
+
+#ifdef LIDAR_SSE2
+//two beams at a time: scale, test the range, multiply by the table, then store without branching;
+//a beam out of range is written anyway and overwritten by the next one because written does not move
+static inline size_t convertPair(__m128d range, size_t i, const BeamTable& table,
+                                 __m128d rangeMin, __m128d rangeMax, Point2D* points, size_t written) {
+    __m128d x = _mm_mul_pd(range, _mm_loadu_pd(&table.cosines[i]));
+    __m128d y = _mm_mul_pd(range, _mm_loadu_pd(&table.sines[i]));
+    int valid = _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(range, rangeMin), _mm_cmple_pd(range, rangeMax)));
+
+    _mm_storeu_pd(&points[written].x, _mm_unpacklo_pd(x, y));
+    written += valid & 1;
+    _mm_storeu_pd(&points[written].x, _mm_unpackhi_pd(x, y));
+    written += (valid >> 1) & 1;
+    return written;
+}
+#endif
+
+size_t convertQuantized(const std::uint16_t* ranges, size_t count, float scale, const Scan& params, Point2D* points) {
+#ifdef LIDAR_SSE2
+    const BeamTable& table = beamTable(params, count);
+    __m128d scaleVec = _mm_set1_pd(scale);
+    __m128d rangeMin = _mm_set1_pd(params.range_min);
+    __m128d rangeMax = _mm_set1_pd(params.range_max);
+    __m128i zero = _mm_setzero_si128();
+
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        //eight uint16 ranges widen to two sets of four int32, each of those to two pairs of doubles
+        __m128i raw = _mm_loadu_si128((const __m128i*)(ranges + i));
+        __m128i low = _mm_unpacklo_epi16(raw, zero);
+        __m128i high = _mm_unpackhi_epi16(raw, zero);
+        __m128d r0 = _mm_mul_pd(_mm_cvtepi32_pd(low), scaleVec);
+        __m128d r1 = _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(low, 8)), scaleVec);
+        __m128d r2 = _mm_mul_pd(_mm_cvtepi32_pd(high), scaleVec);
+        __m128d r3 = _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(high, 8)), scaleVec);
+
+        written = convertPair(r0, i, table, rangeMin, rangeMax, points, written);
+        written = convertPair(r1, i + 2, table, rangeMin, rangeMax, points, written);
+        written = convertPair(r2, i + 4, table, rangeMin, rangeMax, points, written);
+        written = convertPair(r3, i + 6, table, rangeMin, rangeMax, points, written);
+    }
+
+    //the last few beams one at a time
+    for (; i < count; i++) {
+        double range = ranges[i] * (double)scale;
+        if (range < params.range_min || range > params.range_max) continue;
+        points[written].x = range * table.cosines[i];
+        points[written].y = range * table.sines[i];
+        written++;
+    }
+    return written;
+#else
+    return convertQuantizedScalar(ranges, count, scale, params, points);
+#endif
+}
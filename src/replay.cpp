@@ -0,0 +1,160 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "file_read.h"
+#include "replay.h"
+#include "instrument.h"
+#include "scan_archive.h"
+
+//parses the text of one scan from a log
+bool readFrameBlock(const std::string& block, RawFrame& frame) {
+    LIDAR_SCOPE("parse");
+    //every reader searches from the top, so each one gets its own stream over the block
+    std::istringstream headerStream(block), scanStream(block), rangeStream(block), intensityStream(block);
+    frame.header = readHeader(headerStream);
+    frame.scan = readScan(scanStream);
+    frame.ranges = readRanges(rangeStream);
+    frame.intensities = readIntensities(intensityStream);
+    return !frame.ranges.empty();
+}
+
+//reads every scan of a multi-frame log, in the order they were recorded; .lda archives are decoded too
+std::vector<RawFrame> readScanLog(const std::string& filename) {
+    std::vector<RawFrame> frames;
+    if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".lda") == 0) {
+        for (const QuantizedFrame& packed : readScanArchive(filename)) {
+            RawFrame frame;
+            frame.header = packed.header;
+            frame.scan = packed.scan;
+            dequantizeRanges(packed, frame.ranges);
+            dequantizeIntensities(packed, frame.intensities);
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+    for (const std::string& block : readFrameBlocks(filename)) {
+        RawFrame frame;
+        if (readFrameBlock(block, frame)) frames.push_back(frame);
+    }
+    return frames;
+}
+
+std::vector<QuantizedFrame> readScanLogQuantized(const std::string& filename) {
+    if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".lda") == 0)
+        return readScanArchive(filename);
+    //one scan at a time in doubles, only the compact copy of each is kept
+    std::vector<QuantizedFrame> frames;
+    RawFrame raw;
+    for (const std::string& block : readFrameBlocks(filename)) {
+        if (!readFrameBlock(block, raw)) continue;
+        frames.emplace_back();
+        quantizeFrame(raw.header, raw.scan, raw.ranges, raw.intensities, frames.back());
+    }
+    return frames;
+}
+
+/*
+- when each frame is due, in seconds from the start of the replay
+- a scan takes scan_time to record, so the next one arrives scan_time later
+- logs without scan_time are played at 10 Hz
+*/
+template <typename Frame>
+static std::vector<double> arrivalTimes(const std::vector<Frame>& frames, double speed) {
+    std::vector<double> arrival(frames.size(), 0.0);
+    if (speed <= 0) return arrival; //as fast as possible, everything is due right away
+
+    double t = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        arrival[i] = t / speed;
+        t += frames[i].scan.scan_time > 0 ? frames[i].scan.scan_time : 0.1;
+    }
+    return arrival;
+}
+
+std::vector<double> frameArrivalTimes(const std::vector<RawFrame>& frames, double speed) {
+    return arrivalTimes(frames, speed);
+}
+
+std::vector<double> frameArrivalTimes(const std::vector<QuantizedFrame>& frames, double speed) {
+    return arrivalTimes(frames, speed);
+}
+
+//value below which the given fraction of the sorted samples fall
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t idx = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+//feeds the log through processQuantizedFrame on the log's own clock, like a real sensor would
+ReplayReport replayLog(const std::vector<QuantizedFrame>& frames, const PipelineConfig& config,
+                       const ReplayConfig& replay,
+                       const std::function<void(const FrameResult&)>& onFrame) {
+    typedef std::chrono::steady_clock Clock;
+
+    ReplayReport report;
+    report.framesTotal = frames.size();
+    std::vector<double> arrival = frameArrivalTimes(frames, replay.speed);
+    std::vector<double> unpaced = frameArrivalTimes(frames, 1.0);
+    if (!frames.empty()) {
+        double lastScan = frames.back().scan.scan_time > 0 ? frames.back().scan.scan_time : 0.1;
+        report.logSeconds = unpaced.back() + lastScan;
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(frames.size());
+    FrameResult result;
+
+    Clock::time_point start = Clock::now();
+    auto elapsed = [&]() { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+    size_t i = 0;
+    while (i < frames.size()) {
+        //wait for the sensor
+        double now = elapsed();
+        if (now < arrival[i]) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(arrival[i] - now));
+            now = elapsed();
+        }
+
+        //behind schedule: newer frames already arrived, so jump to the newest one
+        if (replay.dropFrames && replay.speed > 0) {
+            size_t newest = i;
+            while (newest + 1 < frames.size() && arrival[newest + 1] <= now) newest++;
+            report.framesDropped += newest - i;
+            i = newest;
+        }
+
+        //at max speed a frame is "due" when we get to it, so latency is just the processing time
+        double due = replay.speed > 0 ? arrival[i] : now;
+        processQuantizedFrame(frames[i], config, result);
+        result.sequence = i + 1;
+        latencies.push_back((elapsed() - due) * 1000.0);
+        report.framesProcessed++;
+        if (onFrame) onFrame(result);
+        i++;
+    }
+
+    report.wallSeconds = elapsed();
+    report.achievedFps = report.wallSeconds > 0 ? report.framesProcessed / report.wallSeconds : 0;
+    std::sort(latencies.begin(), latencies.end());
+    report.latencyP50Ms = percentile(latencies, 0.50);
+    report.latencyP99Ms = percentile(latencies, 0.99);
+    report.latencyMaxMs = latencies.empty() ? 0 : latencies.back();
+    return report;
+}
+
+void printReplayReport(const ReplayReport& report) {
+    std::cout << "\n=== Replay Results ===" << "\n";
+    std::cout << "Frames: " << report.framesProcessed << " processed, " << report.framesDropped
+              << " dropped, " << report.framesTotal << " in log" << "\n";
+    std::cout << "Time: " << report.wallSeconds << " s wall, " << report.logSeconds << " s of log" << "\n";
+    std::cout << "Achieved: " << report.achievedFps << " fps" << "\n";
+    std::cout << "Latency: p50 " << report.latencyP50Ms << " ms, p99 " << report.latencyP99Ms
+              << " ms, max " << report.latencyMaxMs << " ms" << std::endl;
+}
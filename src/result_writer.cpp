@@ -0,0 +1,332 @@
+#include <iostream>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "result_writer.h"
+
+//longest double std::to_chars produces in its shortest round-trip form, with room to spare
+static const size_t numberChars = 32;
+
+ResultWriter::ResultWriter(size_t bufferBytes) : buffer(bufferBytes) {}
+
+ResultWriter::~ResultWriter() {
+    close();
+}
+
+bool ResultWriter::open(const std::string& filename, ResultFormat format) {
+    close();
+    file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Could not open " << filename << std::endl;
+        return false;
+    }
+    //the buffer here already batches everything, a second one in stdio would only copy it again
+    std::setvbuf(file, nullptr, _IONBF, 0);
+    this->format = format;
+    used = 0;
+    written = 0;
+    frames = 0;
+    failed = false;
+
+    if (format == ResultFormat::Csv) {
+        //one header for all three kinds of rows, each row fills its own columns and leaves the rest empty
+        putText("record,sequence,frame_id,stamp,points,detection_ms,iterations,partial,pose_x,pose_y,pose_yaw,"
+                "index,a,b,c,inliers,line1,line2,x,y,angle,distance,landmark\n");
+    } else if (format == ResultFormat::Binary) {
+        putText("LDRS", 4);
+        putRaw(resultBinaryVersion);
+    }
+    return true;
+}
+
+bool ResultWriter::flush() {
+    if (!file) return false;
+    if (used > 0) {
+        if (std::fwrite(buffer.data(), 1, used, file) != used) failed = true;
+        written += used;
+        used = 0;
+    }
+    return !failed;
+}
+
+bool ResultWriter::close() {
+    if (!file) return !failed;
+    flush();
+    if (std::fclose(file) != 0) failed = true;
+    file = nullptr;
+    return !failed;
+}
+
+//room for at least bytes more, contiguous; a record larger than the whole buffer grows it
+char* ResultWriter::reserve(size_t bytes) {
+    if (used + bytes > buffer.size()) {
+        flush();
+        if (bytes > buffer.size()) buffer.resize(bytes);
+    }
+    return buffer.data() + used;
+}
+
+void ResultWriter::putText(const char* text, size_t length) {
+    std::memcpy(reserve(length), text, length);
+    used += length;
+}
+
+void ResultWriter::putText(const char* text) {
+    putText(text, std::strlen(text));
+}
+
+//JSON has no NaN or infinity, and an empty CSV field reads as missing in every tool
+void ResultWriter::putNumber(double value) {
+    if (!std::isfinite(value)) {
+        if (format == ResultFormat::Ndjson) putText("null", 4);
+        return;
+    }
+    char* out = reserve(numberChars);
+    used = std::to_chars(out, out + numberChars, value).ptr - buffer.data();
+}
+
+void ResultWriter::putNumber(long long value) {
+    char* out = reserve(numberChars);
+    used = std::to_chars(out, out + numberChars, value).ptr - buffer.data();
+}
+
+void ResultWriter::putJsonString(const std::string& text) {
+    //worst case every byte becomes a \u00XX escape
+    char* out = reserve(text.size() * 6 + 2);
+    char* p = out;
+    *p++ = '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = (char)c;
+        } else if (c < 0x20) {
+            static const char hex[] = "0123456789abcdef";
+            std::memcpy(p, "\\u00", 4);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 15];
+            p += 6;
+        } else {
+            *p++ = (char)c;
+        }
+    }
+    *p++ = '"';
+    used += p - out;
+}
+
+//quoted only when it has to be, with quotes doubled
+void ResultWriter::putCsvString(const std::string& text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        putText(text.data(), text.size());
+        return;
+    }
+    char* out = reserve(text.size() * 2 + 2);
+    char* p = out;
+    *p++ = '"';
+    for (char c : text) {
+        if (c == '"') *p++ = '"';
+        *p++ = c;
+    }
+    *p++ = '"';
+    used += p - out;
+}
+
+//raw little endian values, like the scan archive
+template <typename T>
+void ResultWriter::putRaw(T value) {
+    std::memcpy(reserve(sizeof(T)), &value, sizeof(T));
+    used += sizeof(T);
+}
+
+void ResultWriter::putShortString(const std::string& text) {
+    std::uint16_t length = (std::uint16_t)std::min<size_t>(text.size(), 0xFFFF);
+    putRaw(length);
+    putText(text.data(), length);
+}
+
+void ResultWriter::write(const FrameResult& frame) {
+    if (!file) return;
+    if (format == ResultFormat::Ndjson) writeNdjson(frame);
+    else if (format == ResultFormat::Csv) writeCsv(frame);
+    else writeBinary(frame);
+    frames++;
+}
+
+void ResultWriter::writeNdjson(const FrameResult& frame) {
+    putText("{\"sequence\":");
+    putNumber((long long)frame.sequence);
+    putText(",\"frame_id\":");
+    putJsonString(frame.header.frame_id);
+    putText(",\"stamp\":");
+    putJsonString(frame.header.stamp);
+    putText(",\"points\":");
+    putNumber((long long)frame.points.size());
+    putText(",\"detection_ms\":");
+    putNumber(frame.stats.elapsedMs);
+    putText(",\"iterations\":");
+    putNumber((long long)frame.stats.iterations);
+    putText(frame.stats.partial ? ",\"partial\":true" : ",\"partial\":false");
+    if (frame.motion.valid) {
+        putText(",\"pose\":[");
+        putNumber(frame.pose.x);
+        putText(",");
+        putNumber(frame.pose.y);
+        putText(",");
+        putNumber(frame.pose.yaw);
+        putText("]");
+    }
+
+    putText(",\"lines\":[");
+    for (size_t i = 0; i < frame.lines.size(); i++) {
+        const Line& line = frame.lines[i];
+        putText(i ? ",{\"a\":" : "{\"a\":");
+        putNumber(line.a);
+        putText(",\"b\":");
+        putNumber(line.b);
+        putText(",\"c\":");
+        putNumber(line.c);
+        putText(",\"inliers\":");
+        putNumber((long long)line.pointIndices.size());
+        putText("}");
+    }
+
+    putText("],\"intersections\":[");
+    for (size_t i = 0; i < frame.intersections.size(); i++) {
+        const Intersection& inter = frame.intersections[i];
+        putText(i ? ",{\"x\":" : "{\"x\":");
+        putNumber(inter.point.x);
+        putText(",\"y\":");
+        putNumber(inter.point.y);
+        putText(",\"line1\":");
+        putNumber((long long)inter.line1_idx);
+        putText(",\"line2\":");
+        putNumber((long long)inter.line2_idx);
+        putText(",\"angle\":");
+        putNumber(inter.angle_degrees);
+        putText(",\"distance\":");
+        putNumber(inter.distance_to_robot);
+        if (i < frame.landmarkIds.size() && frame.landmarkIds[i] >= 0) {
+            putText(",\"landmark\":");
+            putNumber((long long)frame.landmarkIds[i]);
+        }
+        putText("}");
+    }
+    putText("]}\n");
+}
+
+void ResultWriter::writeCsv(const FrameResult& frame) {
+    long long sequence = (long long)frame.sequence;
+    putText("frame,");
+    putNumber(sequence);
+    putText(",");
+    putCsvString(frame.header.frame_id);
+    putText(",");
+    putCsvString(frame.header.stamp);
+    putText(",");
+    putNumber((long long)frame.points.size());
+    putText(",");
+    putNumber(frame.stats.elapsedMs);
+    putText(",");
+    putNumber((long long)frame.stats.iterations);
+    putText(frame.stats.partial ? ",1," : ",0,");
+    if (frame.motion.valid) {
+        putNumber(frame.pose.x);
+        putText(",");
+        putNumber(frame.pose.y);
+        putText(",");
+        putNumber(frame.pose.yaw);
+    } else {
+        putText(",,");
+    }
+    putText(",,,,,,,,,,,,\n");
+
+    for (size_t i = 0; i < frame.lines.size(); i++) {
+        putText("line,");
+        putNumber(sequence);
+        putText(",,,,,,,,,,");
+        putNumber((long long)i);
+        putText(",");
+        putNumber(frame.lines[i].a);
+        putText(",");
+        putNumber(frame.lines[i].b);
+        putText(",");
+        putNumber(frame.lines[i].c);
+        putText(",");
+        putNumber((long long)frame.lines[i].pointIndices.size());
+        putText(",,,,,,,\n");
+    }
+
+    for (size_t i = 0; i < frame.intersections.size(); i++) {
+        const Intersection& inter = frame.intersections[i];
+        putText("intersection,");
+        putNumber(sequence);
+        putText(",,,,,,,,,,,,,,,");
+        putNumber((long long)inter.line1_idx);
+        putText(",");
+        putNumber((long long)inter.line2_idx);
+        putText(",");
+        putNumber(inter.point.x);
+        putText(",");
+        putNumber(inter.point.y);
+        putText(",");
+        putNumber(inter.angle_degrees);
+        putText(",");
+        putNumber(inter.distance_to_robot);
+        putText(",");
+        if (i < frame.landmarkIds.size() && frame.landmarkIds[i] >= 0) putNumber((long long)frame.landmarkIds[i]);
+        putText("\n");
+    }
+}
+
+void ResultWriter::writeBinary(const FrameResult& frame) {
+    std::uint16_t idLength = (std::uint16_t)std::min<size_t>(frame.header.frame_id.size(), 0xFFFF);
+    std::uint16_t stampLength = (std::uint16_t)std::min<size_t>(frame.header.stamp.size(), 0xFFFF);
+    std::uint32_t size = 8 + 2 + idLength + 2 + stampLength + 4 + 8 + 4 + 1 + 3 * 8
+                       + 4 + (std::uint32_t)frame.lines.size() * (3 * 8 + 4)
+                       + 4 + (std::uint32_t)frame.intersections.size() * (4 * 8 + 3 * 4);
+    //the whole record in one piece, so its size field is never split from it by a flush
+    reserve(4 + size);
+
+    putRaw(size);
+    putRaw((std::uint64_t)frame.sequence);
+    putShortString(frame.header.frame_id);
+    putShortString(frame.header.stamp);
+    putRaw((std::uint32_t)frame.points.size());
+    putRaw(frame.stats.elapsedMs);
+    putRaw((std::uint32_t)frame.stats.iterations);
+    putRaw((std::uint8_t)((frame.stats.partial ? 1 : 0) | (frame.motion.valid ? 2 : 0)));
+    putRaw(frame.pose.x);
+    putRaw(frame.pose.y);
+    putRaw(frame.pose.yaw);
+
+    putRaw((std::uint32_t)frame.lines.size());
+    for (const Line& line : frame.lines) {
+        putRaw(line.a);
+        putRaw(line.b);
+        putRaw(line.c);
+        putRaw((std::uint32_t)line.pointIndices.size());
+    }
+
+    putRaw((std::uint32_t)frame.intersections.size());
+    for (size_t i = 0; i < frame.intersections.size(); i++) {
+        const Intersection& inter = frame.intersections[i];
+        putRaw(inter.point.x);
+        putRaw(inter.point.y);
+        putRaw(inter.angle_degrees);
+        putRaw(inter.distance_to_robot);
+        putRaw((std::int32_t)inter.line1_idx);
+        putRaw((std::int32_t)inter.line2_idx);
+        putRaw((std::int32_t)(i < frame.landmarkIds.size() ? frame.landmarkIds[i] : -1));
+    }
+}
+
+ResultFormat resultFormatFor(const std::string& filename) {
+    auto endsWith = [&](const char* suffix) {
+        size_t length = std::strlen(suffix);
+        return filename.size() >= length && filename.compare(filename.size() - length, length, suffix) == 0;
+    };
+    if (endsWith(".csv")) return ResultFormat::Csv;
+    if (endsWith(".bin")) return ResultFormat::Binary;
+    return ResultFormat::Ndjson;
+}
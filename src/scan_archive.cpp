@@ -0,0 +1,339 @@
+#include <iostream>
+#include <cstring>
+
+#include "scan_archive.h"
+
+static const std::uint32_t archiveMagic = 0x4152444C;   //"LDRA"
+static const std::uint32_t indexMagic = 0x4952444C;     //"LDRI"
+static const std::uint32_t footerMagic = 0x4552444C;    //"LDRE"
+static const std::uint32_t archiveVersion = 1;
+static const std::uint64_t keyframeBit = 1ULL << 63;
+
+//payload flags
+static const std::uint8_t flagKeyframe = 0x1;
+static const std::uint8_t flagScanRepeated = 0x2;      //scan parameters and scales as in the previous frame
+static const std::uint8_t flagTemporalRanges = 0x4;    //ranges are deltas against the previous frame
+static const std::uint8_t flagTemporalIntensities = 0x8;
+
+/*
+- Payload:
+-   uint8 flags
+-   varint length + bytes: stamp, frame_id
+-   unless flagScanRepeated: 7 doubles of Scan, float rangeScale, float intensityScale
+-   varint count + zigzag varint deltas: ranges, then intensities
+*/
+
+//raw little endian values, the archive is only written and read on little endian hosts
+template <typename T>
+static void putRaw(std::vector<std::uint8_t>& out, T value) {
+    std::uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static bool getRaw(const std::uint8_t*& p, const std::uint8_t* end, T& value) {
+    if (end - p < (std::ptrdiff_t)sizeof(T)) return false;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+//7 bits per byte, high bit set while more bytes follow
+static void putVarint(std::vector<std::uint8_t>& out, std::uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((std::uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((std::uint8_t)value);
+}
+
+static bool getVarint(const std::uint8_t*& p, const std::uint8_t* end, std::uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        std::uint8_t byte = *p++;
+        value |= (std::uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+//small negative and positive deltas both become small unsigned numbers
+static std::uint32_t zigzag(std::int32_t v) { return ((std::uint32_t)v << 1) ^ (std::uint32_t)(v >> 31); }
+static std::int32_t unzigzag(std::uint32_t v) { return (std::int32_t)(v >> 1) ^ -(std::int32_t)(v & 1); }
+
+static void putString(std::vector<std::uint8_t>& out, const std::string& s) {
+    putVarint(out, s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+static bool getString(const std::uint8_t*& p, const std::uint8_t* end, std::string& s) {
+    std::uint32_t length;
+    if (!getVarint(p, end, length) || end - p < (std::ptrdiff_t)length) return false;
+    s.assign((const char*)p, length);
+    p += length;
+    return true;
+}
+
+//deltas against a reference array (previous frame) or, with no reference, against the previous value
+static void putDeltas(std::vector<std::uint8_t>& out, const std::vector<std::uint16_t>& values,
+                      const std::vector<std::uint16_t>* reference) {
+    putVarint(out, values.size());
+    std::int32_t last = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        std::int32_t base = reference ? (*reference)[i] : last;
+        putVarint(out, zigzag((std::int32_t)values[i] - base));
+        last = values[i];
+    }
+}
+
+static bool getDeltas(const std::uint8_t*& p, const std::uint8_t* end, std::vector<std::uint16_t>& values,
+                      bool temporal) {
+    std::uint32_t count;
+    //every value takes at least one byte, a larger count is a corrupt record
+    if (!getVarint(p, end, count) || count > (std::uint64_t)(end - p)) return false;
+    //a temporal delta reads the previous frame's value from the same slot, so values must still hold it
+    if (temporal && values.size() != count) return false;
+    values.resize(count);
+    std::uint16_t* out = values.data();
+    std::int32_t last = 0;
+    for (size_t i = 0; i < count; i++) {
+        std::uint32_t encoded;
+        //most deltas fit in one byte, only longer ones take the general path
+        if (p < end && *p < 0x80) encoded = *p++;
+        else if (!getVarint(p, end, encoded)) return false;
+        std::int32_t base = temporal ? out[i] : last;
+        last = base + unzigzag(encoded);
+        out[i] = (std::uint16_t)last;
+    }
+    return true;
+}
+
+//picks whichever delta kind is smaller for this frame
+static bool encodeValues(std::vector<std::uint8_t>& out, const std::vector<std::uint16_t>& values,
+                         const std::vector<std::uint16_t>& previous, bool allowTemporal) {
+    size_t start = out.size();
+    putDeltas(out, values, nullptr);
+    if (!allowTemporal || previous.size() != values.size()) return false;
+
+    std::vector<std::uint8_t> temporal;
+    putDeltas(temporal, values, &previous);
+    if (temporal.size() >= out.size() - start) return false;
+    out.resize(start);
+    out.insert(out.end(), temporal.begin(), temporal.end());
+    return true;
+}
+
+static bool sameScan(const QuantizedFrame& a, const QuantizedFrame& b) {
+    return std::memcmp(&a.scan, &b.scan, sizeof(Scan)) == 0 &&
+           a.rangeScale == b.rangeScale && a.intensityScale == b.intensityScale;
+}
+
+ArchiveWriter::~ArchiveWriter() {
+    if (file.is_open()) close();
+}
+
+bool ArchiveWriter::open(const std::string& filename, int keyframeInterval) {
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Archive could not be created: " << filename << std::endl;
+        return false;
+    }
+    this->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+    index.clear();
+
+    std::vector<std::uint8_t> header;
+    putRaw(header, archiveMagic);
+    putRaw(header, archiveVersion);
+    file.write((const char*)header.data(), header.size());
+    offset = header.size();
+    return file.good();
+}
+
+bool ArchiveWriter::write(const QuantizedFrame& frame) {
+    bool keyframe = index.size() % keyframeInterval == 0;
+    bool repeated = !keyframe && sameScan(frame, previous);
+
+    payload.clear();
+    payload.push_back(0);
+    putString(payload, frame.header.stamp);
+    putString(payload, frame.header.frame_id);
+    if (!repeated) {
+        putRaw(payload, frame.scan.angle_min);
+        putRaw(payload, frame.scan.angle_max);
+        putRaw(payload, frame.scan.angle_increment);
+        putRaw(payload, frame.scan.time_increment);
+        putRaw(payload, frame.scan.scan_time);
+        putRaw(payload, frame.scan.range_min);
+        putRaw(payload, frame.scan.range_max);
+        putRaw(payload, frame.rangeScale);
+        putRaw(payload, frame.intensityScale);
+    }
+    //a frame delta only makes sense when both frames use the same scale
+    bool temporalRanges = encodeValues(payload, frame.ranges, previous.ranges, repeated);
+    bool temporalIntensities = encodeValues(payload, frame.intensities, previous.intensities, repeated);
+    payload[0] = (keyframe ? flagKeyframe : 0) | (repeated ? flagScanRepeated : 0) |
+                 (temporalRanges ? flagTemporalRanges : 0) | (temporalIntensities ? flagTemporalIntensities : 0);
+
+    std::vector<std::uint8_t> size;
+    putRaw(size, (std::uint32_t)payload.size());
+    file.write((const char*)size.data(), size.size());
+    file.write((const char*)payload.data(), payload.size());
+
+    index.push_back(offset | (keyframe ? keyframeBit : 0));
+    offset += size.size() + payload.size();
+    previous = frame;
+    return file.good();
+}
+
+bool ArchiveWriter::close() {
+    if (!file.is_open()) return false;
+    std::vector<std::uint8_t> tail;
+    putRaw(tail, indexMagic);
+    putRaw(tail, (std::uint32_t)keyframeInterval);
+    putRaw(tail, (std::uint64_t)index.size());
+    for (std::uint64_t entry : index) putRaw(tail, entry);
+    putRaw(tail, offset);
+    putRaw(tail, footerMagic);
+    file.write((const char*)tail.data(), tail.size());
+    offset += tail.size();
+
+    bool ok = file.good();
+    file.close();
+    return ok;
+}
+
+bool ArchiveReader::open(const std::string& filename) {
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Archive could not be opened: " << filename << std::endl;
+        return false;
+    }
+    index.clear();
+    file.seekg(0, std::ios::end);
+    fileSize = (std::uint64_t)file.tellg();
+    file.seekg(0);
+
+    std::uint32_t magic = 0, version = 0;
+    file.read((char*)&magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+
+    //the footer at the very end says where the index is
+    std::uint64_t indexOffset = 0;
+    std::uint32_t footer = 0;
+    file.seekg(-(std::streamoff)(sizeof(indexOffset) + sizeof(footer)), std::ios::end);
+    file.read((char*)&indexOffset, sizeof(indexOffset));
+    file.read((char*)&footer, sizeof(footer));
+    if (!file || magic != archiveMagic || version != archiveVersion || footer != footerMagic) {
+        std::cerr << "Not a scan archive, or it was not closed: " << filename << std::endl;
+        return false;
+    }
+
+    std::uint32_t imagic = 0, interval = 0;
+    std::uint64_t count = 0;
+    //the index, its header and the footer have to fit in the file before any of it is trusted
+    std::uint64_t indexHeader = sizeof(imagic) + sizeof(interval) + sizeof(count);
+    std::uint64_t footerSize = sizeof(indexOffset) + sizeof(footer);
+    if (fileSize < indexHeader + footerSize || indexOffset > fileSize - indexHeader - footerSize) {
+        std::cerr << "Archive index is outside the file: " << filename << std::endl;
+        return false;
+    }
+    file.seekg(indexOffset);
+    file.read((char*)&imagic, sizeof(imagic));
+    file.read((char*)&interval, sizeof(interval));
+    file.read((char*)&count, sizeof(count));
+    if (!file || imagic != indexMagic) return false;
+    if (count > (fileSize - indexOffset - indexHeader - footerSize) / sizeof(std::uint64_t)) {
+        std::cerr << "Archive index is truncated: " << filename << std::endl;
+        return false;
+    }
+    index.resize(count);
+    file.read((char*)index.data(), count * sizeof(std::uint64_t));
+    position = ~0ULL;
+    currentFrame = -1;
+    return (bool)file;
+}
+
+bool ArchiveReader::isKeyframe(size_t frame) const {
+    return frame < index.size() && (index[frame] & keyframeBit);
+}
+
+//reads and decodes one record on top of the current frame
+bool ArchiveReader::decodeAt(size_t frame) {
+    //seeking drops the stream's buffer, so sequential reads only seek when the stream is elsewhere
+    std::uint64_t offset = index[frame] & ~keyframeBit;
+    if (offset != position) {
+        file.clear();
+        file.seekg(offset);
+    }
+    std::uint32_t size = 0;
+    file.read((char*)&size, sizeof(size));
+    //a record can not reach past the end of the file
+    if (!file || offset + sizeof(size) > fileSize || size > fileSize - offset - sizeof(size)) {
+        position = ~0ULL;
+        return false;
+    }
+    payload.resize(size);
+    file.read((char*)payload.data(), size);
+    position = offset + sizeof(size) + size;
+    if (!file || size == 0) {
+        position = ~0ULL;
+        return false;
+    }
+
+    const std::uint8_t* p = payload.data();
+    const std::uint8_t* end = p + size;
+    std::uint8_t flags = *p++;
+    if (!(flags & flagKeyframe) && currentFrame != (long long)frame - 1) return false;
+
+    if (!getString(p, end, current.header.stamp) || !getString(p, end, current.header.frame_id)) return false;
+    if (!(flags & flagScanRepeated)) {
+        bool ok = getRaw(p, end, current.scan.angle_min) && getRaw(p, end, current.scan.angle_max) &&
+                  getRaw(p, end, current.scan.angle_increment) && getRaw(p, end, current.scan.time_increment) &&
+                  getRaw(p, end, current.scan.scan_time) && getRaw(p, end, current.scan.range_min) &&
+                  getRaw(p, end, current.scan.range_max) &&
+                  getRaw(p, end, current.rangeScale) && getRaw(p, end, current.intensityScale);
+        if (!ok) return false;
+    }
+    if (!getDeltas(p, end, current.ranges, flags & flagTemporalRanges) ||
+        !getDeltas(p, end, current.intensities, flags & flagTemporalIntensities)) return false;
+
+    currentFrame = frame;
+    return true;
+}
+
+bool ArchiveReader::read(size_t frame, QuantizedFrame& out) {
+    if (frame >= index.size()) return false;
+
+    //decode forward from the keyframe before it, unless the last decoded frame is already on the way
+    size_t start = frame;
+    while (start > 0 && !isKeyframe(start)) start--;
+    if (currentFrame >= (long long)start && currentFrame < (long long)frame) start = currentFrame + 1;
+
+    for (size_t f = start; f <= frame; f++) {
+        if (!decodeAt(f)) {
+            currentFrame = -1;
+            return false;
+        }
+    }
+    out = current;
+    return true;
+}
+
+bool ArchiveReader::next(QuantizedFrame& out) {
+    return read(currentFrame + 1, out);
+}
+
+std::vector<QuantizedFrame> readScanArchive(const std::string& filename) {
+    std::vector<QuantizedFrame> frames;
+    ArchiveReader reader;
+    if (!reader.open(filename)) return frames;
+    frames.resize(reader.frameCount());
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (!reader.next(frames[i])) {
+            frames.resize(i);
+            break;
+        }
+    }
+    return frames;
+}
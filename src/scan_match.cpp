@@ -0,0 +1,306 @@
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIDAR_SSE2
+#endif
+
+#include "scan_match.h"
+#include "operations.h"
+#include "instrument.h"
+
+//very large scans would make the grid huge, the cells grow instead
+static const int maxGridCells = 1 << 20;
+
+void buildPointGrid(PointGrid& grid, const std::vector<Point2D>& points, const std::vector<int>& indices, double cellSize) {
+    grid.indices.clear();
+    grid.cellStart.clear();
+    grid.width = grid.height = 0;
+    if (indices.empty()) return;
+
+    double minX = points[indices[0]].x, maxX = minX, minY = points[indices[0]].y, maxY = minY;
+    for (int idx : indices) {
+        minX = std::min(minX, points[idx].x);
+        maxX = std::max(maxX, points[idx].x);
+        minY = std::min(minY, points[idx].y);
+        maxY = std::max(maxY, points[idx].y);
+    }
+    while ((maxX - minX) / cellSize * (maxY - minY) / cellSize > maxGridCells) cellSize *= 2;
+
+    grid.minX = minX;
+    grid.minY = minY;
+    grid.cellSize = cellSize;
+    grid.width = (int)((maxX - minX) / cellSize) + 1;
+    grid.height = (int)((maxY - minY) / cellSize) + 1;
+
+    //counting sort by cell: count, prefix sum, then place
+    std::vector<int> cellOf(indices.size());
+    grid.cellStart.assign(grid.width * grid.height + 1, 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        const Point2D& p = points[indices[i]];
+        int cx = (int)((p.x - minX) / cellSize), cy = (int)((p.y - minY) / cellSize);
+        cellOf[i] = cy * grid.width + cx;
+        grid.cellStart[cellOf[i] + 1]++;
+    }
+    for (size_t c = 1; c < grid.cellStart.size(); c++) grid.cellStart[c] += grid.cellStart[c - 1];
+    grid.indices.resize(indices.size());
+    std::vector<int> fill(grid.cellStart.begin(), grid.cellStart.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) grid.indices[fill[cellOf[i]]++] = indices[i];
+}
+
+void prepareReference(const std::vector<Point2D>& points, const std::vector<Line>& lines, const IcpConfig& config,
+                      IcpReference& reference) {
+    size_t n = points.size();
+    reference.points = points;
+    reference.nx.assign(n, 0);
+    reference.ny.assign(n, 0);
+    reference.d.assign(n, 0);
+
+    //points on a detected wall use the wall, refit over all its inliers since RANSAC's line only passes through two
+    std::vector<bool> onLine(n, false);
+    for (const Line& line : lines) {
+        if (line.pointIndices.size() < 2) continue;
+        double mx = 0, my = 0;
+        for (int idx : line.pointIndices) {
+            mx += points[idx].x;
+            my += points[idx].y;
+        }
+        mx /= line.pointIndices.size();
+        my /= line.pointIndices.size();
+        double sxx = 0, sxy = 0, syy = 0;
+        for (int idx : line.pointIndices) {
+            double dx = points[idx].x - mx, dy = points[idx].y - my;
+            sxx += dx * dx;
+            sxy += dx * dy;
+            syy += dy * dy;
+        }
+        //the normal is the direction the inliers spread least in
+        double direction = 0.5 * std::atan2(2 * sxy, sxx - syy);
+        double nx = -std::sin(direction), ny = std::cos(direction);
+        for (int idx : line.pointIndices) {
+            reference.nx[idx] = nx;
+            reference.ny[idx] = ny;
+            reference.d[idx] = -(nx * mx + ny * my);
+            onLine[idx] = true;
+        }
+    }
+
+    //the rest use the line through the beams on either side, if those are close enough to be the same surface
+    for (size_t i = 1; i + 1 < n; i++) {
+        if (onLine[i]) continue;
+        const Point2D& prev = points[i - 1];
+        const Point2D& next = points[i + 1];
+        if (std::hypot(prev.x - points[i].x, prev.y - points[i].y) > config.maxNeighbourGap ||
+            std::hypot(next.x - points[i].x, next.y - points[i].y) > config.maxNeighbourGap) continue;
+        Line local = createLineFromPoints(prev, next);
+        double norm = std::sqrt(local.a * local.a + local.b * local.b);
+        if (norm < almostZero) continue;
+        reference.nx[i] = local.a / norm;
+        reference.ny[i] = local.b / norm;
+        //the line runs through the point itself, not just parallel to its neighbours
+        reference.d[i] = -(reference.nx[i] * points[i].x + reference.ny[i] * points[i].y);
+    }
+
+    std::vector<int> withLine;
+    withLine.reserve(n);
+    for (size_t i = 0; i < n; i++)
+        if (reference.nx[i] != 0 || reference.ny[i] != 0) withLine.push_back((int)i);
+    buildPointGrid(reference.grid, reference.points, withLine, config.maxCorrespondence);
+}
+
+//nearest reference point with a line within maxDistance, -1 if there is none
+static int nearestReference(const IcpReference& reference, double x, double y, double maxDistance) {
+    const PointGrid& grid = reference.grid;
+    if (grid.width == 0) return -1;
+    int cx = (int)std::floor((x - grid.minX) / grid.cellSize);
+    int cy = (int)std::floor((y - grid.minY) / grid.cellSize);
+    int best = -1;
+    double bestDistance = maxDistance * maxDistance;
+
+    //the cell size is at least maxDistance, so the 3x3 block around the point covers every candidate
+    for (int gy = std::max(cy - 1, 0); gy <= std::min(cy + 1, grid.height - 1); gy++) {
+        for (int gx = std::max(cx - 1, 0); gx <= std::min(cx + 1, grid.width - 1); gx++) {
+            int cell = gy * grid.width + gx;
+            for (int k = grid.cellStart[cell]; k < grid.cellStart[cell + 1]; k++) {
+                const Point2D& r = reference.points[grid.indices[k]];
+                double dx = r.x - x, dy = r.y - y;
+                double distance = dx * dx + dy * dy;
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = grid.indices[k];
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/*
+- Normal equations of one Gauss-Newton step, summed over all pairs
+- For a pair with rotated point q = R p, moved point q + t, reference line (n, d):
+-   residual r = n . (q + t) + d
+-   jacobian J = [nx, ny, nx * -qy + ny * qx]   with respect to (x, y, yaw)
+- H = sum J^T J (upper half), g = sum J^T r
+*/
+struct NormalEquations {
+    double h00 = 0, h01 = 0, h02 = 0, h11 = 0, h12 = 0, h22 = 0;
+    double g0 = 0, g1 = 0, g2 = 0;
+    double squaredError = 0;
+};
+
+//pairs as separate arrays, so two of them fit in one SSE2 register
+struct PairArrays {
+    std::vector<double> qx, qy, nx, ny, r;
+    void clear() { qx.clear(); qy.clear(); nx.clear(); ny.clear(); r.clear(); }
+};
+
+static void accumulateScalar(const PairArrays& pairs, size_t first, NormalEquations& eq) {
+    for (size_t i = first; i < pairs.r.size(); i++) {
+        double j2 = pairs.ny[i] * pairs.qx[i] - pairs.nx[i] * pairs.qy[i];
+        double nx = pairs.nx[i], ny = pairs.ny[i], r = pairs.r[i];
+        eq.h00 += nx * nx; eq.h01 += nx * ny; eq.h02 += nx * j2;
+        eq.h11 += ny * ny; eq.h12 += ny * j2; eq.h22 += j2 * j2;
+        eq.g0 += nx * r; eq.g1 += ny * r; eq.g2 += j2 * r;
+        eq.squaredError += r * r;
+    }
+}
+
+static NormalEquations accumulate(const PairArrays& pairs) {
+    NormalEquations eq;
+    size_t i = 0;
+#ifdef LIDAR_SSE2
+    __m128d h00 = _mm_setzero_pd(), h01 = h00, h02 = h00, h11 = h00, h12 = h00, h22 = h00;
+    __m128d g0 = h00, g1 = h00, g2 = h00, e = h00;
+    for (; i + 2 <= pairs.r.size(); i += 2) {
+        __m128d qx = _mm_loadu_pd(&pairs.qx[i]), qy = _mm_loadu_pd(&pairs.qy[i]);
+        __m128d nx = _mm_loadu_pd(&pairs.nx[i]), ny = _mm_loadu_pd(&pairs.ny[i]);
+        __m128d r = _mm_loadu_pd(&pairs.r[i]);
+        __m128d j2 = _mm_sub_pd(_mm_mul_pd(ny, qx), _mm_mul_pd(nx, qy));
+        h00 = _mm_add_pd(h00, _mm_mul_pd(nx, nx));
+        h01 = _mm_add_pd(h01, _mm_mul_pd(nx, ny));
+        h02 = _mm_add_pd(h02, _mm_mul_pd(nx, j2));
+        h11 = _mm_add_pd(h11, _mm_mul_pd(ny, ny));
+        h12 = _mm_add_pd(h12, _mm_mul_pd(ny, j2));
+        h22 = _mm_add_pd(h22, _mm_mul_pd(j2, j2));
+        g0 = _mm_add_pd(g0, _mm_mul_pd(nx, r));
+        g1 = _mm_add_pd(g1, _mm_mul_pd(ny, r));
+        g2 = _mm_add_pd(g2, _mm_mul_pd(j2, r));
+        e = _mm_add_pd(e, _mm_mul_pd(r, r));
+    }
+    //both lanes added together
+    auto sum = [](__m128d v) {
+        double lanes[2];
+        _mm_storeu_pd(lanes, v);
+        return lanes[0] + lanes[1];
+    };
+    eq.h00 = sum(h00); eq.h01 = sum(h01); eq.h02 = sum(h02);
+    eq.h11 = sum(h11); eq.h12 = sum(h12); eq.h22 = sum(h22);
+    eq.g0 = sum(g0); eq.g1 = sum(g1); eq.g2 = sum(g2);
+    eq.squaredError = sum(e);
+#endif
+    accumulateScalar(pairs, i, eq);
+    return eq;
+}
+
+//solves H step = -g by Cramer's rule; a tiny damping keeps directions the scene does not constrain (a corridor) still
+static bool solveStep(const NormalEquations& eq, size_t count, double step[3]) {
+    double damping = 1e-6 * count;
+    double a = eq.h00 + damping, b = eq.h01, c = eq.h02;
+    double e = eq.h11 + damping, f = eq.h12, i = eq.h22 + damping;
+    double det = a * (e * i - f * f) - b * (b * i - f * c) + c * (b * f - e * c);
+    if (std::fabs(det) < almostZero) return false;
+
+    double r0 = -eq.g0, r1 = -eq.g1, r2 = -eq.g2;
+    step[0] = (r0 * (e * i - f * f) - b * (r1 * i - f * r2) + c * (r1 * f - e * r2)) / det;
+    step[1] = (a * (r1 * i - f * r2) - r0 * (b * i - f * c) + c * (b * r2 - r1 * c)) / det;
+    step[2] = (a * (e * r2 - r1 * f) - b * (b * r2 - r1 * c) + r0 * (b * f - e * c)) / det;
+    return true;
+}
+
+IcpResult matchScans(const IcpReference& reference, const std::vector<Point2D>& points, const Pose2D& initial,
+                     const IcpConfig& config) {
+    LIDAR_SCOPE("icp");
+    auto start = std::chrono::steady_clock::now();
+    IcpResult result;
+    result.pose = initial;
+    PairArrays pairs;
+
+    for (int iteration = 0; iteration < config.maxIterations; iteration++) {
+        double c = std::cos(result.pose.yaw), s = std::sin(result.pose.yaw);
+        pairs.clear();
+        for (const Point2D& p : points) {
+            double qx = c * p.x - s * p.y, qy = s * p.x + c * p.y;
+            double x = qx + result.pose.x, y = qy + result.pose.y;
+            int ref = nearestReference(reference, x, y, config.maxCorrespondence);
+            if (ref < 0) continue;
+            pairs.qx.push_back(qx);
+            pairs.qy.push_back(qy);
+            pairs.nx.push_back(reference.nx[ref]);
+            pairs.ny.push_back(reference.ny[ref]);
+            pairs.r.push_back(reference.nx[ref] * x + reference.ny[ref] * y + reference.d[ref]);
+        }
+
+        result.iterations = iteration + 1;
+        result.correspondences = (int)pairs.r.size();
+        if (result.correspondences < config.minCorrespondences) {
+            result.valid = false;
+            break;
+        }
+
+        NormalEquations eq = accumulate(pairs);
+        result.rms = std::sqrt(eq.squaredError / result.correspondences);
+        double step[3];
+        result.valid = solveStep(eq, pairs.r.size(), step);
+        if (!result.valid) break;
+
+        result.pose.x += step[0];
+        result.pose.y += step[1];
+        result.pose.yaw += step[2];
+        if (std::hypot(step[0], step[1]) < config.convergeTranslation && std::fabs(step[2]) < config.convergeRotation) {
+            result.converged = true;
+            break;
+        }
+    }
+
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+//b applied after a: a point in b's frame, moved into a's frame and then into a's parent
+Pose2D composePose(const Pose2D& a, const Pose2D& b) {
+    double c = std::cos(a.yaw), s = std::sin(a.yaw);
+    Pose2D out;
+    out.x = a.x + c * b.x - s * b.y;
+    out.y = a.y + s * b.x + c * b.y;
+    out.yaw = std::atan2(std::sin(a.yaw + b.yaw), std::cos(a.yaw + b.yaw));
+    return out;
+}
+
+IcpResult ScanOdometry::addScan(const std::vector<Point2D>& points, const std::vector<Line>& lines) {
+    IcpResult result;
+    if (!hasReference) {
+        result.valid = true;
+        result.converged = true;
+    }
+    else {
+        result = matchScans(reference, points, lastMotion, config);
+        if (result.valid) {
+            current = composePose(current, result.pose);
+            lastMotion = result.pose;
+        }
+        //a failed match keeps the pose and starts the next one from standing still
+        else lastMotion = Pose2D();
+    }
+
+    prepareReference(points, lines, config, reference);
+    hasReference = true;
+    return result;
+}
+
+void ScanOdometry::reset() {
+    hasReference = false;
+    current = Pose2D();
+    lastMotion = Pose2D();
+}
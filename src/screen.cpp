@@ -4,8 +4,19 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
 
 #include "constants.h"
+#include "screen.h"
 
 //finds the distance between two points
 double distancePointsToPoints(const Point2D& p, const Point2D& q) {
@@ -13,7 +24,7 @@ double distancePointsToPoints(const Point2D& p, const Point2D& q) {
 }
 
 //create dots
-int addDot (sf::RenderWindow& window, float size, bool dotAlign, float posX, 
+int addDot (sf::RenderTarget& window, float size, bool dotAlign, float posX, 
             float posY, sf::Color color) {
     sf::CircleShape circle(size, 60); //default number of corners for circle shape
     circle.setFillColor(color); //default color of circle
@@ -26,9 +37,9 @@ int addDot (sf::RenderWindow& window, float size, bool dotAlign, float posX,
     return 1;
 }
 
-//create texts
-int addText (sf::RenderWindow& window, sf::Font& font, std::string message, 
-            float size, sf::Color color, bool textAlign, float posX, float posY, bool setRotate) {
+//lay out a text, so it can be drawn right away or kept and drawn again later
+sf::Text makeText (sf::Font& font, std::string message, float size, sf::Color color, 
+                   bool textAlign, float posX, float posY, bool setRotate) {
     sf::Text text(font, message, size);
     text.setFillColor(color);
     sf::FloatRect bounds = text.getLocalBounds();
@@ -39,12 +50,18 @@ int addText (sf::RenderWindow& window, sf::Font& font, std::string message,
 
     if (setRotate) text.setRotation(sf::degrees(90.f));
 
-    window.draw(text);
+    return text;
+}
+
+//create texts
+int addText (sf::RenderTarget& window, sf::Font& font, std::string message, 
+            float size, sf::Color color, bool textAlign, float posX, float posY, bool setRotate) {
+    window.draw(makeText(font, message, size, color, textAlign, posX, posY, setRotate));
     return 1;
 }
 
 //create lines
-int addLine (sf::RenderWindow& window, float sizeX, float sizeY, float posX, float posY, sf::Color color, float angle, bool centerContent) {
+int addLine (sf::RenderTarget& window, float sizeX, float sizeY, float posX, float posY, sf::Color color, float angle, bool centerContent) {
     sf::RectangleShape rect({sizeX, sizeY});
     rect.setFillColor(color);
     if (centerContent) rect.setOrigin({sizeX/2, sizeY/2});
@@ -56,6 +73,79 @@ int addLine (sf::RenderWindow& window, float sizeX, float sizeY, float posX, flo
     return 0;
 }
 
+//white disc that every batched dot samples from, tinted by the vertex color
+static const sf::Texture& dotTexture() {
+    static sf::Texture texture;
+    static bool loaded = false;
+    if (!loaded) {
+        const unsigned size = 64;
+        const float radius = size / 2.f;
+        sf::Image image({size, size}, sf::Color::Transparent);
+        for (unsigned x = 0; x < size; x++) {
+            for (unsigned y = 0; y < size; y++) {
+                float dx = x + 0.5f - radius;
+                float dy = y + 0.5f - radius;
+                //one pixel of soft edge so small dots still look round
+                float coverage = std::min(1.f, std::max(0.f, radius - std::sqrt(dx*dx + dy*dy)));
+                image.setPixel({x, y}, sf::Color(255, 255, 255, (std::uint8_t)(coverage * 255)));
+            }
+        }
+        loaded = texture.loadFromImage(image);
+        texture.setSmooth(true);
+    }
+    return texture;
+}
+
+//empty the batch but keep its memory for the next frame
+void clearBatch(RenderBatch& batch) {
+    batch.cells.clear();
+    batch.dots.clear();
+    batch.lines.clear();
+    batch.markers.clear();
+}
+
+//append a centered dot as two textured triangles, same look as addDot with dotAlign
+void batchDot(sf::VertexArray& batch, float size, float posX, float posY, sf::Color color) {
+    float texSize = (float)dotTexture().getSize().x;
+    sf::Vector2f topLeft(posX - size, posY - size), topRight(posX + size, posY - size);
+    sf::Vector2f bottomLeft(posX - size, posY + size), bottomRight(posX + size, posY + size);
+
+    batch.append({topLeft, color, {0.f, 0.f}});
+    batch.append({topRight, color, {texSize, 0.f}});
+    batch.append({bottomRight, color, {texSize, texSize}});
+    batch.append({topLeft, color, {0.f, 0.f}});
+    batch.append({bottomRight, color, {texSize, texSize}});
+    batch.append({bottomLeft, color, {0.f, texSize}});
+}
+
+//append a rotated rectangle as two triangles, same geometry as addLine without centerContent
+void batchLine(sf::VertexArray& batch, float sizeX, float sizeY, float posX, float posY, sf::Color color, float angle) {
+    float rad = angle * M_PI / 180.f;
+    float cosA = std::cos(rad), sinA = std::sin(rad);
+
+    //rotate the rectangle corners around its top left corner, then move it to its position
+    sf::Vector2f p0(posX, posY);
+    sf::Vector2f p1(posX + sizeX*cosA, posY + sizeX*sinA);
+    sf::Vector2f p2(posX + sizeX*cosA - sizeY*sinA, posY + sizeX*sinA + sizeY*cosA);
+    sf::Vector2f p3(posX - sizeY*sinA, posY + sizeY*cosA);
+
+    batch.append({p0, color});
+    batch.append({p1, color});
+    batch.append({p2, color});
+    batch.append({p0, color});
+    batch.append({p2, color});
+    batch.append({p3, color});
+}
+
+//four draw calls no matter how many points, lines and markers there are
+void drawBatch(sf::RenderTarget& target, const RenderBatch& batch) {
+    sf::RenderStates dotStates(&dotTexture());
+    target.draw(batch.cells);
+    target.draw(batch.dots, dotStates);
+    target.draw(batch.lines);
+    target.draw(batch.markers, dotStates);
+}
+
 // every 100.f is 1 in this coordinate scaling (its defined by gridscale)
 float convertCoordinateX(float x, float scale) {
     float convx = x*scale + originX;  
@@ -67,8 +157,118 @@ float convertCoordinateY(float y, float scale) {
     return convy;
 }
 
+//same mapping for any pan and zoom: the viewport's center lands on the middle of the frame
+float convertCoordinateX(double x, const Viewport& view) {
+    return (x - view.centerX)*view.scale + originX;
+}
+
+float convertCoordinateY(double y, const Viewport& view) {
+    return -(y - view.centerY)*view.scale + originY;  //Y axis is inverted on screen
+}
+
+//inverse of convertCoordinateX/Y, used for the mouse and the visible area
+Point2D screenToWorld(float screenX, float screenY, const Viewport& view) {
+    Point2D p;
+    p.x = view.centerX + (screenX - originX) / view.scale;
+    p.y = view.centerY - (screenY - originY) / view.scale;
+    return p;
+}
+
+//zoom keeping the world point under (screenX, screenY) where it is
+void zoomViewport(Viewport& view, float factor, float screenX, float screenY) {
+    Point2D anchor = screenToWorld(screenX, screenY, view);
+    view.scale = std::min(std::max(view.scale * factor, minZoomScale), maxZoomScale);
+    view.centerX = anchor.x - (screenX - originX) / view.scale;
+    view.centerY = anchor.y + (screenY - originY) / view.scale;
+}
+
+//move the view by a mouse drag of (dx, dy) pixels
+void panViewport(Viewport& view, float dx, float dy) {
+    view.centerX -= dx / view.scale;
+    view.centerY += dy / view.scale;
+}
+
+/*
+- mouse wheel zooms around the cursor, left drag pans
+- arrow keys pan, +/- zoom around the frame center, Home goes back to the default view
+- returns true if the view changed and the screen has to be redrawn
+*/
+bool handleViewportEvent(Viewport& view, const sf::Event& event, const sf::RenderWindow& window) {
+    if (auto wheel = event.getIf<sf::Event::MouseWheelScrolled>()) {
+        sf::Vector2f mouse = window.mapPixelToCoords(wheel->position);
+        zoomViewport(view, std::pow(1.2f, wheel->delta), mouse.x, mouse.y);
+        return true;
+    }
+    if (auto press = event.getIf<sf::Event::MouseButtonPressed>()) {
+        if (press->button != sf::Mouse::Button::Left) return false;
+        sf::Vector2f mouse = window.mapPixelToCoords(press->position);
+        view.dragging = true;
+        view.dragX = mouse.x;
+        view.dragY = mouse.y;
+        return false;
+    }
+    if (auto release = event.getIf<sf::Event::MouseButtonReleased>()) {
+        if (release->button == sf::Mouse::Button::Left) view.dragging = false;
+        return false;
+    }
+    if (auto move = event.getIf<sf::Event::MouseMoved>()) {
+        if (!view.dragging) return false;
+        sf::Vector2f mouse = window.mapPixelToCoords(move->position);
+        panViewport(view, mouse.x - view.dragX, mouse.y - view.dragY);
+        view.dragX = mouse.x;
+        view.dragY = mouse.y;
+        return true;
+    }
+    if (auto key = event.getIf<sf::Event::KeyPressed>()) {
+        switch (key->code) {
+            case sf::Keyboard::Key::Left:  panViewport(view, 50.f, 0.f); return true;
+            case sf::Keyboard::Key::Right: panViewport(view, -50.f, 0.f); return true;
+            case sf::Keyboard::Key::Up:    panViewport(view, 0.f, 50.f); return true;
+            case sf::Keyboard::Key::Down:  panViewport(view, 0.f, -50.f); return true;
+            case sf::Keyboard::Key::Add:
+            case sf::Keyboard::Key::Equal:    zoomViewport(view, 1.25f, originX, originY); return true;
+            case sf::Keyboard::Key::Subtract:
+            case sf::Keyboard::Key::Hyphen:   zoomViewport(view, 0.8f, originX, originY); return true;
+            case sf::Keyboard::Key::Home:     view = Viewport(); return true;
+            default: return false;
+        }
+    }
+    return false;
+}
+
+//world rectangle that is visible inside the graph frame
+void visibleWorldRect(const Viewport& view, double& minX, double& minY, double& maxX, double& maxY) {
+    Point2D topLeft = screenToWorld(margin_X, margin_Y, view);
+    Point2D bottomRight = screenToWorld(margin_X + frame_X, margin_Y + frame_Y, view);
+    minX = topLeft.x;
+    maxX = bottomRight.x;
+    minY = bottomRight.y;
+    maxY = topLeft.y;
+}
+
+//world distance between grid lines, a 1-2-5 step that keeps lines about 100 px apart
+double gridStep(const Viewport& view) {
+    double target = 100.0 / view.scale;
+    double base = std::pow(10.0, std::floor(std::log10(target)));
+    double step = base;
+    for (double m : {2.0, 5.0, 10.0}) {
+        //pick the candidate closest to the target on a log scale
+        if (std::fabs(std::log(base*m / target)) < std::fabs(std::log(step / target))) step = base*m;
+    }
+    return step;
+}
+
+//axis numbers get as many decimals as the grid step needs
+std::string formatAxisValue(double value, double step) {
+    int decimals = std::max(0, (int)-std::floor(std::log10(step) + 1e-9));
+    if (std::fabs(value) < step * 1e-6) value = 0; //no "-0"
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(decimals) << value;
+    return out.str();
+}
+
 //creating the main frame of our graph
-void mainFrame(sf::RenderWindow& window, sf::Font& font, float sizeX, float sizeY,
+void mainFrame(sf::RenderTarget& window, sf::Font& font, const Viewport& view, float sizeX, float sizeY,
                float posX, float posY, int thickness) {
     //creating the frame that will hold the graph, transparent by default for now
     sf::RectangleShape rect({sizeX, sizeY});
@@ -76,19 +276,22 @@ void mainFrame(sf::RenderWindow& window, sf::Font& font, float sizeX, float size
     rect.setOutlineThickness(thickness);
     rect.setOutlineColor(sf::Color::Transparent);
     rect.setPosition({posX, posY});
+
+    double step = gridStep(view);
+    Point2D topLeft = screenToWorld(posX, posY, view);
+    Point2D bottomRight = screenToWorld(posX + sizeX, posY + sizeY, view);
     
-    //putting numbers on x-axis with with relevant numbers
-    int xAxis = -3;
-    for (float i=margin_X; i<=sizeX + margin_X; i+=gridscale) {
-        if (xAxis != -3) addText(window, font, std::to_string(xAxis), thickness*5, sf::Color::Black, false, i, screen_Y - margin_Y+5.f, false);
-        xAxis++;
+    //putting numbers on x-axis at every grid line, the left corner belongs to the y-axis numbers
+    for (long k = (long)std::ceil(topLeft.x / step); k <= (long)std::floor(bottomRight.x / step); k++) {
+        float i = convertCoordinateX(k*step, view);
+        if (i - posX < 10.f) continue;
+        addText(window, font, formatAxisValue(k*step, step), thickness*5, sf::Color::Black, false, i, posY + sizeY + 5.f, false);
     }
 
-    //putting numbers on y-axis with relevant numbers
-    int yAxis = +3;
-    for (float j=margin_Y; j<=sizeY + margin_Y; j+=gridscale) {
-        addText(window, font, std::to_string(yAxis), thickness*5, sf::Color::Black, false, margin_X-15.f, j, false);
-        yAxis--;
+    //putting numbers on y-axis at every grid line
+    for (long k = (long)std::floor(topLeft.y / step); k >= (long)std::ceil(bottomRight.y / step); k--) {
+        float j = convertCoordinateY(k*step, view);
+        addText(window, font, formatAxisValue(k*step, step), thickness*5, sf::Color::Black, false, posX - 15.f, j, false);
     }
 
     window.draw(rect);
@@ -96,76 +299,259 @@ void mainFrame(sf::RenderWindow& window, sf::Font& font, float sizeX, float size
 
 
 //dots layout
-void screen(sf::RenderWindow& window, float scale, sf::Font font, 
+void screen(sf::RenderTarget& window, const Viewport& view, 
             float startX, float startY, float endX, float endY) {
-    std::string numStr;
-
-    //putting dots seperately
-    for (float i=startX; i<=endX; i+=5.f*scale) {
-        for (float j=startY; j<=endY; j+=5.f*scale) {
-            //check for the corners
-            if ((i==startX && j==startY) || (i==endX && j==startY) || (i ==startX && j==endY) || (i==endX && j==endY)) 
-                addDot(window, 2.f, true, i, j, gray);
-            else addDot(window, 2.f, true, i, j, gray);
+    RenderBatch batch;
+    double step = gridStep(view);
+    double dotStep = step / 10;
+    Point2D topLeft = screenToWorld(startX, startY, view);
+    Point2D bottomRight = screenToWorld(endX, endY, view);
+
+    //putting dots seperately, ten per grid square, wherever the view is
+    for (long kx = (long)std::ceil(topLeft.x / dotStep - 1e-6); kx <= (long)std::floor(bottomRight.x / dotStep + 1e-6); kx++) {
+        for (long ky = (long)std::ceil(bottomRight.y / dotStep - 1e-6); ky <= (long)std::floor(topLeft.y / dotStep + 1e-6); ky++) {
+            batchDot(batch.dots, 2.f, convertCoordinateX(kx*dotStep, view), convertCoordinateY(ky*dotStep, view), gray);
         }
     }
-    //Vertical lines (vary X)
-    for (float x=startX+100.f; x<endX; x+=100.f) {
-        if (!(x==startX || x==endX)) {
-            if (x == margin_X+(endX-startX)/2) addLine(window, 2.f, endY-startY, x, startY, darkGray, 0.f, false);
-            else addLine(window, 2.f, endY-startY, x, startY, gray, 0.f, false);
-        }
+    //Vertical lines (vary X), the one through the robot is darker
+    for (long k = (long)std::ceil(topLeft.x / step); k <= (long)std::floor(bottomRight.x / step); k++) {
+        float x = convertCoordinateX(k*step, view);
+        if (x - startX < 1.f || endX - x < 1.f) continue; //frame border
+        if (k == 0) batchLine(batch.lines, 2.f, endY-startY, x, startY, darkGray, 0.f);
+        else batchLine(batch.lines, 2.f, endY-startY, x, startY, gray, 0.f);
     }
     //Horizontal lines (vary Y)
-    for (float y=startY+100.f; y<endY; y+=100.f) { //the window's y axis + 100f get us the start of the actual start of frame's y axis, until the end of the graph we put lines  
-        if (!(y==startY || y==endY)){
-            if (y == margin_Y+(endY-startY)/2) addLine(window, endX-startX, 2.f, startX, y, darkGray, 0.f, false);
-            else addLine(window, endX-startX, 2.f, startX, y, gray, 0.f, false); // the horizontal(yatay) lines are end - start size, x varies here
-        } 
+    for (long k = (long)std::ceil(bottomRight.y / step); k <= (long)std::floor(topLeft.y / step); k++) {
+        float y = convertCoordinateY(k*step, view);
+        if (y - startY < 1.f || endY - y < 1.f) continue;
+        if (k == 0) batchLine(batch.lines, endX-startX, 2.f, startX, y, darkGray, 0.f);
+        else batchLine(batch.lines, endX-startX, 2.f, startX, y, gray, 0.f); // the horizontal(yatay) lines are end - start size, x varies here
+    }
+    drawBatch(window, batch);
+}
+
+//grid, axis numbers and frame size labels only change with the view, so they are rendered into a texture
+bool buildStaticLayer(StaticLayer& layer, sf::Font& font, const Viewport& view) {
+    if (!layer.ready && !layer.texture.resize({(unsigned int) screen_X, (unsigned int) screen_Y})) {
+        std::cerr << "Static layer texture could not be created" << std::endl;
+        return false;
     }
+    layer.texture.clear(sf::Color::White);
+
+    screen(layer.texture, view, margin_X, margin_Y, frame_X+margin_X, frame_Y+margin_Y);
+    mainFrame(layer.texture, font, view, frame_X, frame_Y, margin_X, margin_Y, 2);
+    addText(layer.texture, font, std::to_string((int)frame_X), 10, sf::Color::Black, 
+            false, frame_X/2+margin_X, margin_Y-30.f, false);
+    addText(layer.texture, font, std::to_string((int)frame_Y), 10, sf::Color::Black, 
+            false, margin_X-50.f, screen_Y/2, false);
+
+    layer.texture.display();
+    layer.ready = true;
+    return true;
+}
+
+//one sprite draw replaces the few thousand grid shapes
+void drawStaticLayer(sf::RenderTarget& target, const StaticLayer& layer) {
+    if (!layer.ready) return;
+    sf::Sprite sprite(layer.texture.getTexture());
+    target.draw(sprite);
+}
+
+//draw the scene batch clipped to the graph frame, so panned geometry does not cover the axes
+void drawBatchInFrame(sf::RenderTarget& target, const RenderBatch& batch) {
+    sf::View frameView(sf::FloatRect({margin_X, margin_Y}, {frame_X, frame_Y}));
+    frameView.setViewport(sf::FloatRect({margin_X/screen_X, margin_Y/screen_Y}, {frame_X/screen_X, frame_Y/screen_Y}));
+    target.setView(frameView);
+    drawBatch(target, batch);
+    target.setView(target.getDefaultView());
+}
+
+//events after which what is on screen is stale; everything else can wait
+bool eventNeedsRedraw(const sf::Event& event) {
+    return event.is<sf::Event::Resized>() || event.is<sf::Event::FocusGained>() ||
+           event.is<sf::Event::MouseEntered>();
+}
+
+//user + kernel time this process used so far, in seconds
+double processCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creation, exitTime, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) return 0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;   u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 1e-7; //FILETIME counts 100ns ticks
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+//count one paint towards the current stats interval
+void recordFrame(FrameStats& stats, float frameMs) {
+    stats.lastFrameMs = frameMs;
+    stats.intervalFrameMs += frameMs;
+    stats.intervalPaints++;
+}
+
+//closes the stats interval when it is due, returns true if the overlay has new numbers
+bool updateFrameStats(FrameStats& stats, const RedrawPolicy& policy) {
+    double cpuNow = processCpuSeconds();
+    if (stats.intervalCpuStart < 0) {
+        stats.intervalCpuStart = cpuNow;
+        stats.intervalClock.restart();
+        return false;
+    }
+
+    float wall = stats.intervalClock.getElapsedTime().asSeconds();
+    if (wall < policy.statsInterval) return false;
+
+    stats.cpuPercent = (float)((cpuNow - stats.intervalCpuStart) / wall * 100.0);
+    stats.avgFrameMs = stats.intervalPaints ? stats.intervalFrameMs / stats.intervalPaints : 0;
+    stats.paintsPerInterval = stats.intervalPaints;
+
+    stats.intervalCpuStart = cpuNow;
+    stats.intervalClock.restart();
+    stats.intervalFrameMs = 0;
+    stats.intervalPaints = 0;
+    return true;
+}
+
+//small overlay in the top left corner
+void drawFrameStats(sf::RenderTarget& target, sf::Font& font, const FrameStats& stats) {
+    std::string frameStr = std::to_string(stats.lastFrameMs);
+    std::string avgStr = std::to_string(stats.avgFrameMs);
+    std::string cpuStr = std::to_string(stats.cpuPercent);
+    std::string label = "frame " + frameStr.substr(0, frameStr.find('.') + 3) + " ms (avg " +
+                        avgStr.substr(0, avgStr.find('.') + 3) + ")  cpu " +
+                        cpuStr.substr(0, cpuStr.find('.') + 2) + "%  paints " +
+                        std::to_string(stats.paintsPerInterval);
+    addText(target, font, label, 10, sf::Color::Black, false, 10.f, 10.f, false);
+}
+
+//a value with a fixed number of decimals, for the overlays
+static std::string formatFixed(double value, int decimals) {
+    std::string text = std::to_string(value);
+    return decimals > 0 ? text.substr(0, text.find('.') + decimals + 1) : text.substr(0, text.find('.'));
+}
+
+StaleStages handleTuningEvent(TuningState& state, const sf::Event& event) {
+    auto key = event.getIf<sf::Event::KeyPressed>();
+    if (!key) return StaleStages::None;
+
+    RANSACparameters& ransac = state.config.ransac;
+    int direction = 0;
+    switch (key->code) {
+        case sf::Keyboard::Key::Tab:
+            state.selected = (state.selected + (key->shift ? 3 : 1)) % 4;
+            return StaleStages::None;
+        case sf::Keyboard::Key::R:
+            state.config = state.initial;
+            return StaleStages::Detection;
+        case sf::Keyboard::Key::RBracket: direction = 1; break;
+        case sf::Keyboard::Key::LBracket: direction = -1; break;
+        default: return StaleStages::None;
+    }
+
+    //steps are relative for the settings that span orders of magnitude
+    switch (state.selected) {
+        case 0:
+            ransac.minPoints = std::max(2, ransac.minPoints + direction);
+            return StaleStages::Detection;
+        case 1:
+            ransac.distanceThreshold = std::min(1.0, std::max(0.001, ransac.distanceThreshold * (direction > 0 ? 1.25 : 0.8)));
+            return StaleStages::Detection;
+        case 2:
+            ransac.maxIterations = std::min(1000000, std::max(10, direction > 0 ? ransac.maxIterations * 2 : ransac.maxIterations / 2));
+            return StaleStages::Detection;
+        default:
+            state.config.minAngleThreshold = std::min(90.0, std::max(0.0, state.config.minAngleThreshold + 5.0 * direction));
+            return StaleStages::Intersections;
+    }
+}
+
+//settings panel in the bottom left corner, the selected one is marked
+void drawTuningHud(sf::RenderTarget& target, sf::Font& font, const TuningState& state, const RANSACstats& stats) {
+    const RANSACparameters& ransac = state.config.ransac;
+    std::string lines[4] = {
+        "min points " + std::to_string(ransac.minPoints),
+        "distance threshold " + formatFixed(ransac.distanceThreshold * 100, 2) + " cm",
+        "max iterations " + std::to_string(ransac.maxIterations),
+        "min angle " + formatFixed(state.config.minAngleThreshold, 0) + " deg"
+    };
+
+    float y = screen_Y - 110.f;
+    for (int i = 0; i < 4; i++) {
+        bool selected = i == state.selected;
+        addText(target, font, (selected ? "> " : "   ") + lines[i], 12, selected ? darkGreen : sf::Color::Black,
+                false, 10.f, y, false);
+        y += 16.f;
+    }
+    std::string status = state.busy ? "recomputing..." :
+                         "detection " + formatFixed(stats.elapsedMs, 1) + " ms, " + std::to_string(stats.iterations) + " iterations";
+    addText(target, font, status, 10, sf::Color::Black, false, 10.f, y, false);
+    addText(target, font, "Tab select   [ ] change   R reset", 10, darkGray, false, 10.f, y + 14.f, false);
 }
 
 //Draws Dots that are in range
-void drawInRangeDots(sf::RenderWindow& window, sf::Font& font, Point2D& point, int precision, sf::Color color) {
+void drawInRangeDots(RenderBatch& batch, const Point2D& point, sf::Color color, const Viewport& view) {
     double posX=point.x, posY=point.y;
 
-    posX = convertCoordinateX(posX, gridscale);
-    posY = convertCoordinateY(posY, gridscale);
+    posX = convertCoordinateX(posX, view);
+    posY = convertCoordinateY(posY, view);
+
+    batchDot(batch.dots, 3, posX, posY, color);
+}
+
+//a square standing in for all points of a quadtree node, darker the more points it holds
+void drawDensityCell(RenderBatch& batch, const DensityCell& cell, sf::Color baseColor, const Viewport& view) {
+    float left = convertCoordinateX(cell.minX, view);
+    float top = convertCoordinateY(cell.minY + cell.size, view);
+    float size = std::max((float)(cell.size * view.scale), 1.f);
 
-    addDot(window, 3, true, posX, posY, color);
+    int alpha = std::min(255, 60 + (int)(40 * std::log2((double)cell.count)));
+    sf::Color color(baseColor.r, baseColor.g, baseColor.b, (std::uint8_t)alpha);
+    batchLine(batch.cells, size, size, left, top, color, 0.f);
 }
 
 //create the robot
-void robot(sf::RenderWindow& window, sf::Font& font) {
-    addDot(window, 7, true, frame_X/2+margin_X, frame_Y/2+margin_Y, sf::Color::Red);
-    addText(window, font, "Robot", 10, sf::Color::Red, true, frame_X/2+margin_X, frame_Y/2+margin_Y+10.f, false);
+void robot(sf::RenderTarget& window, sf::Font& font, const Viewport& view) {
+    float robotX = convertCoordinateX(0, view);
+    float robotY = convertCoordinateY(0, view);
+    //panned out of the frame
+    if (robotX < margin_X || robotX > margin_X + frame_X || robotY < margin_Y || robotY > margin_Y + frame_Y) return;
+
+    addDot(window, 7, true, robotX, robotY, sf::Color::Red);
+    addText(window, font, "Robot", 10, sf::Color::Red, true, robotX, robotY+10.f, false);
 }
 
 //draw a line between two points
-void drawLineBetweenPoints(sf::RenderWindow& window, const Point2D& p1, const Point2D& p2,
-                          sf::Color color, float thickness = 2.0f) {
+void drawLineBetweenPoints(RenderBatch& batch, const Point2D& p1, const Point2D& p2,
+                          sf::Color color, const Viewport& view, float thickness) {
     //Convert coordinates
-    float screenX1 = convertCoordinateX(p1.x, gridscale);
-    float screenY1 = convertCoordinateY(p1.y, gridscale);
-    float screenX2 = convertCoordinateX(p2.x, gridscale);
-    float screenY2 = convertCoordinateY(p2.y, gridscale);
+    float screenX1 = convertCoordinateX(p1.x, view);
+    float screenY1 = convertCoordinateY(p1.y, view);
+    float screenX2 = convertCoordinateX(p2.x, view);
+    float screenY2 = convertCoordinateY(p2.y, view);
     
     float dx = screenX2 - screenX1;
     float dy = screenY2 - screenY1;
     float length = std::sqrt(dx * dx + dy * dy);
     float angle = std::atan2(dy, dx) * 180.0f / M_PI;
     
-    addLine(window, length, thickness, screenX1, screenY1, color, angle, false);
+    batchLine(batch.lines, length, thickness, screenX1, screenY1, color, angle);
 }
 
 //draw a dashed line between two points
-void drawDashedLineBetweenPoints(sf::RenderWindow& window, const Point2D& p1, const Point2D& p2,
-                                 sf::Color color, float thickness = 2.0f, float dashLength = 10.0f) {
+void drawDashedLineBetweenPoints(RenderBatch& batch, const Point2D& p1, const Point2D& p2,
+                                 sf::Color color, const Viewport& view, float thickness, float dashLength) {
     //converting to screen coordinates
-    float screenX1 = convertCoordinateX(p1.x, gridscale);
-    float screenY1 = convertCoordinateY(p1.y, gridscale);
-    float screenX2 = convertCoordinateX(p2.x, gridscale);
-    float screenY2 = convertCoordinateY(p2.y, gridscale);
+    float screenX1 = convertCoordinateX(p1.x, view);
+    float screenY1 = convertCoordinateY(p1.y, view);
+    float screenX2 = convertCoordinateX(p2.x, view);
+    float screenY2 = convertCoordinateY(p2.y, view);
     
     //calculate distance and direction
     float dx = screenX2 - screenX1;
@@ -185,15 +571,15 @@ void drawDashedLineBetweenPoints(sf::RenderWindow& window, const Point2D& p1, co
             float currentY = screenY1 + ndy * d;
             float currentDashLength = std::min(dashLength * 0.6f, totalLength - d);
             
-            addLine(window, currentDashLength, thickness, currentX, currentY, color, angle, false);
+            batchLine(batch.lines, currentDashLength, thickness, currentX, currentY, color, angle);
         }
         drawDash = !drawDash;
     }
 }
 
 //draw a line
-void drawDetectedLine(sf::RenderWindow& window, const std::vector<Point2D>& points, 
-                     const Line& line, sf::Color color) {
+void drawDetectedLine(RenderBatch& batch, const std::vector<Point2D>& points, 
+                     const Line& line, sf::Color color, const Viewport& view) {
     if (line.pointIndices.size() < 2) return;
     
     Point2D firstPoint = points[line.pointIndices.front()];
@@ -204,35 +590,49 @@ void drawDetectedLine(sf::RenderWindow& window, const std::vector<Point2D>& poin
     float dy = lastPoint.y - firstPoint.y;
     float length = std::sqrt(dx*dx + dy*dy);
     
-    drawLineBetweenPoints(window, firstPoint, lastPoint, color, 3.0f);
+    drawLineBetweenPoints(batch, firstPoint, lastPoint, color, view, 3.0f);
 }
 
 //mark intersections
-void drawIntersectionMarker(sf::RenderWindow& window, sf::Font& font, 
-                           const Intersection& intersection, bool showLabel = true) {
+void drawIntersectionMarker(RenderBatch& batch, const Intersection& intersection, const Viewport& view) {
     //convert to screen coordinates
-    float screenX = convertCoordinateX(intersection.point.x, gridscale);
-    float screenY = convertCoordinateY(intersection.point.y, gridscale);
+    float screenX = convertCoordinateX(intersection.point.x, view);
+    float screenY = convertCoordinateY(intersection.point.y, view);
     
-    addDot(window, 4, true, screenX, screenY, sf::Color::Red);     
-    addDot(window, 3, true, screenX, screenY, sf::Color::White);    
-    addDot(window, 2, true, screenX, screenY, sf::Color::Red);      
-
-    if (showLabel) {
-        std::string angleStr = std::to_string((int)intersection.angle_degrees) + "\u00B0";
-        std::string distStr = std::to_string((int)(intersection.distance_to_robot * 100)) + "cm";
-        std::string label = angleStr + " " + distStr;
-        
-        addText(window, font, label, 15, sf::Color::Red, false, 
-               screenX + 15, screenY - 5, false);
-    }
+    batchDot(batch.markers, 4, screenX, screenY, sf::Color::Red);     
+    batchDot(batch.markers, 3, screenX, screenY, sf::Color::White);    
+    batchDot(batch.markers, 2, screenX, screenY, sf::Color::Red);      
+}
+
+//angle and distance written next to an intersection
+sf::Text makeIntersectionLabel(sf::Font& font, const Intersection& intersection, const Viewport& view) {
+    float screenX = convertCoordinateX(intersection.point.x, view);
+    float screenY = convertCoordinateY(intersection.point.y, view);
+
+    std::string angleStr = std::to_string((int)intersection.angle_degrees) + "\u00B0";
+    std::string distStr = std::to_string((int)(intersection.distance_to_robot * 100)) + "cm";
+    std::string label = angleStr + " " + distStr;
+    
+    return makeText(font, label, 15, sf::Color::Red, false, 
+                    screenX + 15, screenY - 5, false);
+}
+
+//"L1", "L2"... written at the middle point of each detected line
+sf::Text makeLineLabel(sf::Font& boldFont, const std::vector<Point2D>& points, const Line& line, int lineNumber, const Viewport& view) {
+    size_t midIdx = line.pointIndices.size() / 2;
+    Point2D midPoint = points[line.pointIndices[midIdx]];
+    float screenX = convertCoordinateX(midPoint.x, view);
+    float screenY = convertCoordinateY(midPoint.y, view);
+    
+    std::string label = "L" + std::to_string(lineNumber);
+    return makeText(boldFont, label, 12, sf::Color::Black, false, screenX, screenY - 15, false);
 }
 
 //side bar for showing
-void drawLegend(sf::RenderWindow& window, sf::Font& font, int numLines, 
-                int numIntersections, std::vector<Line>& detectedLines,
-                std::vector<Point2D>& allDots,
-                std::vector<Intersection>& validIntersections) {
+void drawLegend(sf::RenderTarget& window, sf::Font& font, int numLines, 
+                int numIntersections, const std::vector<Line>& detectedLines,
+                const std::vector<Point2D>& allDots,
+                const std::vector<Intersection>& validIntersections) {
     float legendX = frame_X+ margin_X + 15;
     float legendY = margin_Y + 10;
     float lineHeight = 18;
@@ -300,5 +700,55 @@ void drawLegend(sf::RenderWindow& window, sf::Font& font, int numLines,
            legendX + 15, currentY, false);
 }
 
+//text only changes with the result, so the legend and labels are laid out once per result
+bool updateLabelCache(LabelCache& cache, sf::Font& font, sf::Font& boldFont,
+                      const std::vector<Point2D>& points, const std::vector<Line>& lines,
+                      const std::vector<Intersection>& intersections, unsigned long version,
+                      const Viewport& view, unsigned long viewVersion) {
+    if (cache.version == version && cache.viewVersion == viewVersion) return true;
+
+    //legend panel is the strip right of the graph, rendered into its own texture
+    float panelX = frame_X + margin_X;
+    if (!cache.legendReady) {
+        if (!cache.legend.resize({(unsigned int)(screen_X - panelX), (unsigned int) screen_Y})) {
+            std::cerr << "Legend texture could not be created" << std::endl;
+            return false;
+        }
+        //keep drawLegend's window coordinates by viewing the same strip of the screen
+        cache.legend.setView(sf::View(sf::FloatRect({panelX, 0.f}, {screen_X - panelX, screen_Y})));
+        cache.legendReady = true;
+    }
+    //the legend only depends on the result, labels also move with the view
+    if (cache.version != version) {
+        cache.legend.clear(sf::Color::White);
+        drawLegend(cache.legend, font, lines.size(), intersections.size(), lines, points, intersections);
+        cache.legend.display();
+    }
+
+    cache.lineLabels.clear();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (!lines[i].pointIndices.empty())
+            cache.lineLabels.push_back(makeLineLabel(boldFont, points, lines[i], i + 1, view));
+    }
+
+    cache.intersectionLabels.clear();
+    for (const Intersection& inter : intersections)
+        cache.intersectionLabels.push_back(makeIntersectionLabel(font, inter, view));
+
+    cache.version = version;
+    cache.viewVersion = viewVersion;
+    return true;
+}
 
+//no layout happens here, only the prebuilt texts and one legend sprite are drawn
+void drawLabelCache(sf::RenderTarget& target, const LabelCache& cache) {
+    //legend panel is opaque, so it goes first and labels near the edge stay visible
+    if (cache.legendReady) {
+        sf::Sprite legend(cache.legend.getTexture());
+        legend.setPosition({frame_X + margin_X, 0.f});
+        target.draw(legend);
+    }
 
+    for (const sf::Text& text : cache.lineLabels) target.draw(text);
+    for (const sf::Text& text : cache.intersectionLabels) target.draw(text);
+}
@@ -0,0 +1,271 @@
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "shm_ring.h"
+#include "operations.h"
+
+//the header gets its own cache line, every slot starts on one
+static const size_t cacheLine = 64;
+static size_t roundUp(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+}
+
+std::int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//maps a named shared memory region, creating it with the given size if asked to
+static void* mapShared(const std::string& name, size_t size, bool create, std::intptr_t& handle) {
+#ifdef _WIN32
+    std::string path = "Local\\" + name;
+    HANDLE mapping = create
+        ? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                             (DWORD)((std::uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), path.c_str())
+        : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path.c_str());
+    if (!mapping) return nullptr;
+    void* base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!base) {
+        CloseHandle(mapping);
+        return nullptr;
+    }
+    handle = (std::intptr_t)mapping;
+    return base;
+#else
+    std::string path = "/" + name;
+    int fd = shm_open(path.c_str(), create ? O_CREAT | O_RDWR : O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    if (create && ftruncate(fd, size) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ::close(fd);
+        return nullptr;
+    }
+    handle = fd;
+    return base;
+#endif
+}
+
+static void unmapShared(void*& base, size_t size, std::intptr_t& handle) {
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (handle != -1) CloseHandle((HANDLE)handle);
+#else
+    if (base) munmap(base, size);
+    if (handle != -1) ::close((int)handle);
+#endif
+    base = nullptr;
+    handle = -1;
+}
+
+static ShmSlot* slotAt(void* base, std::uint64_t frame) {
+    ShmRingHeader* ring = (ShmRingHeader*)base;
+    char* slots = (char*)base + roundUp(sizeof(ShmRingHeader), cacheLine);
+    return (ShmSlot*)(slots + (frame % ring->slotCount) * ring->slotBytes);
+}
+
+static float* slotRanges(ShmSlot* slot) {
+    return (float*)((char*)slot + sizeof(ShmSlot));
+}
+
+ShmRingWriter::~ShmRingWriter() {
+    close();
+}
+
+bool ShmRingWriter::create(const std::string& name, size_t slotCount, size_t maxBeams) {
+    close();
+    size_t slotBytes = roundUp(sizeof(ShmSlot) + maxBeams * sizeof(float), cacheLine);
+    size = roundUp(sizeof(ShmRingHeader), cacheLine) + slotCount * slotBytes;
+    base = mapShared(name, size, true, handle);
+    if (!base) {
+        std::cerr << "Shared memory " << name << " could not be created" << std::endl;
+        return false;
+    }
+    this->name = name;
+
+    //a ring left behind by an earlier driver is simply reset
+    ShmRingHeader* ring = (ShmRingHeader*)base;
+    ring->magic = 0;
+    ring->version = shmRingVersion;
+    ring->slotCount = slotCount;
+    ring->maxBeams = maxBeams;
+    ring->slotBytes = slotBytes;
+    new (&ring->published) std::atomic<std::uint64_t>(0);
+    for (size_t i = 0; i < slotCount; i++) {
+        ShmSlot* slot = slotAt(base, i);
+        new (&slot->seq) std::atomic<std::uint64_t>(0);
+        slot->frameNumber = ~(std::uint64_t)0;
+    }
+    //readers check the magic last, so they never see a half built ring
+    std::atomic_thread_fence(std::memory_order_release);
+    ring->magic = shmRingMagic;
+    frameNumber = 0;
+    return true;
+}
+
+void ShmRingWriter::close() {
+    unmapShared(base, size, handle);
+#ifndef _WIN32
+    //the name goes away with the driver, attached readers keep their mapping
+    if (!name.empty()) shm_unlink(("/" + name).c_str());
+#endif
+    name.clear();
+    current = nullptr;
+}
+
+//fixed size text field: cut off at the field size, no terminator when it is full, zeros after the text
+static void copyTextField(char* field, size_t fieldSize, const std::string& text) {
+    size_t length = std::min(text.size(), fieldSize);
+    std::memcpy(field, text.data(), length);
+    std::memset(field + length, 0, fieldSize - length);
+}
+
+float* ShmRingWriter::beginFrame(const Header& header, const Scan& scan, size_t rangeCount) {
+    ShmRingHeader* ring = (ShmRingHeader*)base;
+    if (!base || rangeCount > ring->maxBeams) return nullptr;
+
+    //odd sequence: readers that land on this slot now will retry
+    current = slotAt(base, frameNumber);
+    std::uint64_t seq = current->seq.load(std::memory_order_relaxed);
+    current->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    current->frameNumber = frameNumber;
+    current->rangeCount = rangeCount;
+    copyTextField(current->stamp, sizeof(current->stamp), header.stamp);
+    copyTextField(current->frameId, sizeof(current->frameId), header.frame_id);
+    current->angle_min = scan.angle_min;
+    current->angle_max = scan.angle_max;
+    current->angle_increment = scan.angle_increment;
+    current->time_increment = scan.time_increment;
+    current->scan_time = scan.scan_time;
+    current->range_min = scan.range_min;
+    current->range_max = scan.range_max;
+    return slotRanges(current);
+}
+
+void ShmRingWriter::commitFrame() {
+    if (!current) return;
+    current->writeTimeNs = steadyNowNs();
+    current->seq.store(current->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    ((ShmRingHeader*)base)->published.store(++frameNumber, std::memory_order_release);
+    current = nullptr;
+}
+
+bool ShmRingWriter::writeFrame(const Header& header, const Scan& scan, const std::vector<double>& ranges) {
+    float* out = beginFrame(header, scan, ranges.size());
+    if (!out) return false;
+    for (size_t i = 0; i < ranges.size(); i++) out[i] = (float)ranges[i];
+    commitFrame();
+    return true;
+}
+
+ShmRingReader::~ShmRingReader() {
+    close();
+}
+
+bool ShmRingReader::open(const std::string& name) {
+    close();
+    //map the header alone first to learn how large the ring is
+    size = sizeof(ShmRingHeader);
+    base = mapShared(name, size, false, handle);
+    if (!base) {
+        std::cerr << "Shared memory " << name << " not found, is the driver running?" << std::endl;
+        return false;
+    }
+    ShmRingHeader* ring = (ShmRingHeader*)base;
+    bool valid = ring->magic == shmRingMagic && ring->version == shmRingVersion;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    size_t total = roundUp(sizeof(ShmRingHeader), cacheLine) + (size_t)ring->slotCount * ring->slotBytes;
+    unmapShared(base, size, handle);
+    if (!valid) {
+        std::cerr << "Shared memory " << name << " is not a scan ring" << std::endl;
+        return false;
+    }
+
+    size = total;
+    base = mapShared(name, size, false, handle);
+    if (!base) return false;
+
+    //start with whatever the driver publishes next
+    nextFrame = ((ShmRingHeader*)base)->published.load(std::memory_order_acquire);
+    return true;
+}
+
+void ShmRingReader::close() {
+    unmapShared(base, size, handle);
+}
+
+bool ShmRingReader::readLatest(Header& header, Scan& scan, std::vector<Point2D>& points, int timeoutMs) {
+    if (!base) return false;
+    ShmRingHeader* ring = (ShmRingHeader*)base;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    int idle = 0;
+
+    while (true) {
+        std::uint64_t published = ring->published.load(std::memory_order_acquire);
+        if (published > nextFrame) {
+            std::uint64_t frame = published - 1;
+            ShmSlot* slot = slotAt(base, frame);
+            std::uint64_t before = slot->seq.load(std::memory_order_acquire);
+            if ((before & 1) || slot->frameNumber != frame) {
+                //the driver already lapped us on this slot, go for the newer frame
+                tornCount++;
+                continue;
+            }
+
+            header.stamp.assign(slot->stamp, strnlen(slot->stamp, sizeof(slot->stamp)));
+            header.frame_id.assign(slot->frameId, strnlen(slot->frameId, sizeof(slot->frameId)));
+            scan.angle_min = slot->angle_min;
+            scan.angle_max = slot->angle_max;
+            scan.angle_increment = slot->angle_increment;
+            scan.time_increment = slot->time_increment;
+            scan.scan_time = slot->scan_time;
+            scan.range_min = slot->range_min;
+            scan.range_max = slot->range_max;
+            size_t count = std::min<size_t>(slot->rangeCount, ring->maxBeams);
+            std::int64_t writeTime = slot->writeTimeNs;
+
+            //the only pass over the ranges, straight out of shared memory
+            points.resize(count);
+            size_t converted = convertToCarterisan(slotRanges(slot), count, scan, points.data());
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->seq.load(std::memory_order_relaxed) != before) {
+                tornCount++;
+                continue;
+            }
+            points.resize(converted);
+
+            skippedCount += frame - nextFrame;
+            nextFrame = frame + 1;
+            readCount++;
+            latencyMs = (steadyNowNs() - writeTime) / 1e6;
+            return true;
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        //spin first so a frame that is just about to land is picked up in microseconds, then back off
+        idle++;
+        if (idle < 2000) continue;
+        if (idle < 4000) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
@@ -0,0 +1,397 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+#include "snapshot.h"
+
+//colours of constants.h, which cannot be included here without SFML
+struct Rgba {
+    std::uint8_t r, g, b, a;
+};
+static const Rgba white = {255, 255, 255, 255};
+static const Rgba red = {255, 0, 0, 255};
+static const Rgba green = {0, 255, 0, 255};
+static const Rgba darkGreen = {5, 137, 0, 255};
+static const Rgba gridGray = {150, 200, 255, 60};
+static const Rgba darkGray = {176, 200, 224, 255};
+static const float densityCellPixels = 4.f;
+
+//pixel writes with clipping and alpha blending; everything below goes through these two
+static inline void blendPixel(Image& image, int x, int y, Rgba c) {
+    if (x < 0 || y < 0 || x >= image.width || y >= image.height) return;
+    std::uint8_t* p = &image.pixels[((size_t)y * image.width + x) * 3];
+    if (c.a == 255) {
+        p[0] = c.r;
+        p[1] = c.g;
+        p[2] = c.b;
+        return;
+    }
+    p[0] = (std::uint8_t)((p[0] * (255 - c.a) + c.r * c.a) / 255);
+    p[1] = (std::uint8_t)((p[1] * (255 - c.a) + c.g * c.a) / 255);
+    p[2] = (std::uint8_t)((p[2] * (255 - c.a) + c.b * c.a) / 255);
+}
+
+static void fillRect(Image& image, int x0, int y0, int x1, int y1, Rgba c) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, image.width);
+    y1 = std::min(y1, image.height);
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++) blendPixel(image, x, y, c);
+}
+
+//same size as batchDot: radius in pixels around the centre
+static void fillCircle(Image& image, float cx, float cy, float radius, Rgba c) {
+    if (cx < -radius || cy < -radius || cx > image.width + radius || cy > image.height + radius) return;
+    int top = (int)std::floor(cy - radius), bottom = (int)std::ceil(cy + radius);
+    for (int y = top; y <= bottom; y++) {
+        float dy = y + 0.5f - cy;
+        float span = radius * radius - dy * dy;
+        if (span < 0) continue;
+        float half = std::sqrt(span);
+        int x0 = (int)std::ceil(cx - half - 0.5f), x1 = (int)std::floor(cx + half - 0.5f);
+        for (int x = x0; x <= x1; x++) blendPixel(image, x, y, c);
+    }
+}
+
+//clips the segment to the image grown by the thickness, so zoomed in lines do not walk off screen
+static bool clipSegment(float& x0, float& y0, float& x1, float& y1, float minX, float minY, float maxX, float maxY) {
+    float t0 = 0, t1 = 1;
+    float dx = x1 - x0, dy = y1 - y0;
+    float p[4] = {-dx, dx, -dy, dy};
+    float q[4] = {x0 - minX, maxX - x0, y0 - minY, maxY - y0};
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0) {
+            if (q[i] < 0) return false;
+            continue;
+        }
+        float t = q[i] / p[i];
+        if (p[i] < 0) t0 = std::max(t0, t);
+        else t1 = std::min(t1, t);
+        if (t0 > t1) return false;
+    }
+    float sx = x0, sy = y0;
+    x0 = sx + t0 * dx;
+    y0 = sy + t0 * dy;
+    x1 = sx + t1 * dx;
+    y1 = sy + t1 * dy;
+    return true;
+}
+
+//one step per pixel along the major axis, filling a span of the thickness across it
+static void drawThickLine(Image& image, float x0, float y0, float x1, float y1, float thickness, Rgba c) {
+    if (!clipSegment(x0, y0, x1, y1, -thickness, -thickness, image.width + thickness, image.height + thickness)) return;
+    float dx = x1 - x0, dy = y1 - y0;
+    int steps = (int)std::ceil(std::max(std::fabs(dx), std::fabs(dy)));
+    if (steps == 0) steps = 1;
+    bool vertical = std::fabs(dy) > std::fabs(dx);
+    //a diagonal line needs a longer span for the same visible width
+    float span = thickness * std::sqrt(dx * dx + dy * dy) / std::max(std::max(std::fabs(dx), std::fabs(dy)), 1e-6f);
+    int half = std::max(0, (int)std::lround(span / 2 - 0.5f));
+    int width = std::max(1, (int)std::lround(span));
+    for (int i = 0; i <= steps; i++) {
+        float x = x0 + dx * i / steps, y = y0 + dy * i / steps;
+        int px = (int)std::floor(x), py = (int)std::floor(y);
+        if (vertical) for (int k = 0; k < width; k++) blendPixel(image, px - half + k, py, c);
+        else for (int k = 0; k < width; k++) blendPixel(image, px, py - half + k, c);
+    }
+}
+
+//copies of convertCoordinateX/Y and gridStep for an image instead of the window frame
+static inline float toImageX(double x, const SnapshotView& view) {
+    return (float)((x - view.centerX) * view.scale + view.width / 2.0);
+}
+
+static inline float toImageY(double y, const SnapshotView& view) {
+    return (float)(-(y - view.centerY) * view.scale + view.height / 2.0);
+}
+
+static double snapshotGridStep(const SnapshotView& view) {
+    double target = 100.0 / view.scale;
+    double base = std::pow(10.0, std::floor(std::log10(target)));
+    double step = base;
+    for (double m : {2.0, 5.0, 10.0}) {
+        if (std::fabs(std::log(base*m / target)) < std::fabs(std::log(step / target))) step = base*m;
+    }
+    return step;
+}
+
+static void drawGrid(Image& image, const SnapshotView& view) {
+    double step = snapshotGridStep(view);
+    double dotStep = step / 10;
+    double minX = view.centerX - view.width / 2.0 / view.scale, maxX = view.centerX + view.width / 2.0 / view.scale;
+    double minY = view.centerY - view.height / 2.0 / view.scale, maxY = view.centerY + view.height / 2.0 / view.scale;
+
+    for (long kx = (long)std::ceil(minX / dotStep - 1e-6); kx <= (long)std::floor(maxX / dotStep + 1e-6); kx++)
+        for (long ky = (long)std::ceil(minY / dotStep - 1e-6); ky <= (long)std::floor(maxY / dotStep + 1e-6); ky++)
+            fillCircle(image, toImageX(kx*dotStep, view), toImageY(ky*dotStep, view), 2.f, gridGray);
+
+    for (long k = (long)std::ceil(minX / step); k <= (long)std::floor(maxX / step); k++) {
+        int x = (int)std::lround(toImageX(k*step, view));
+        if (x < 1 || image.width - x < 1) continue;
+        fillRect(image, x, 0, x + 2, image.height, k == 0 ? darkGray : gridGray);
+    }
+    for (long k = (long)std::ceil(minY / step); k <= (long)std::floor(maxY / step); k++) {
+        int y = (int)std::lround(toImageY(k*step, view));
+        if (y < 1 || image.height - y < 1) continue;
+        fillRect(image, 0, y, image.width, y + 2, k == 0 ? darkGray : gridGray);
+    }
+}
+
+/*
+- Same layers in the same order as the window: grid, raw points or density cells, line points and
+- lines, intersection markers, robot
+*/
+void renderSnapshot(const FrameResult& frame, const SnapshotView& view, Image& image) {
+    image.width = view.width;
+    image.height = view.height;
+    image.pixels.assign((size_t)view.width * view.height * 3, 255);
+    drawGrid(image, view);
+
+    double minX = view.centerX - view.width / 2.0 / view.scale, maxX = view.centerX + view.width / 2.0 / view.scale;
+    double minY = view.centerY - view.height / 2.0 / view.scale, maxY = view.centerY + view.height / 2.0 / view.scale;
+
+    //zoomed far out the quadtree hands back whole cells instead of their points, like drawVisiblePoints
+    std::vector<int> visible;
+    std::vector<DensityCell> cells;
+    auto drawPoints = [&](Rgba base) {
+        for (const DensityCell& cell : cells) {
+            int alpha = std::min(255, 60 + (int)(40 * std::log2((double)cell.count)));
+            Rgba color = {base.r, base.g, base.b, (std::uint8_t)alpha};
+            int left = (int)std::floor(toImageX(cell.minX, view));
+            int top = (int)std::floor(toImageY(cell.minY + cell.size, view));
+            int size = std::max(1, (int)std::lround(cell.size * view.scale));
+            fillRect(image, left, top, left + size, top + size, color);
+        }
+        for (int idx : visible)
+            fillCircle(image, toImageX(frame.points[idx].x, view), toImageY(frame.points[idx].y, view), 3.f, base);
+    };
+
+    if (!frame.tree.nodes.empty()) {
+        queryQuadTree(frame.tree, frame.points, minX, minY, maxX, maxY, densityCellPixels / view.scale, visible, cells);
+    } else {
+        for (size_t i = 0; i < frame.points.size(); i++) visible.push_back((int)i);
+    }
+    drawPoints(darkGray);
+
+    //the points of the lines the same way, from their own tree
+    cells.clear();
+    visible.clear();
+    if (!frame.lineTree.nodes.empty()) {
+        queryQuadTree(frame.lineTree, frame.points, minX, minY, maxX, maxY, densityCellPixels / view.scale, visible, cells);
+    } else {
+        for (const Line& line : frame.lines)
+            for (int idx : line.pointIndices) {
+                const Point2D& p = frame.points[idx];
+                if (p.x >= minX && p.x <= maxX && p.y >= minY && p.y <= maxY) visible.push_back(idx);
+            }
+    }
+    drawPoints(green);
+
+    for (const Line& line : frame.lines) {
+        if (line.pointIndices.size() < 2) continue;
+        const Point2D& first = frame.points[line.pointIndices.front()];
+        const Point2D& last = frame.points[line.pointIndices.back()];
+        drawThickLine(image, toImageX(first.x, view), toImageY(first.y, view),
+                      toImageX(last.x, view), toImageY(last.y, view), 3.f, darkGreen);
+    }
+
+    for (const Intersection& inter : frame.intersections) {
+        float x = toImageX(inter.point.x, view), y = toImageY(inter.point.y, view);
+        fillCircle(image, x, y, 4.f, red);
+        fillCircle(image, x, y, 3.f, white);
+        fillCircle(image, x, y, 2.f, red);
+    }
+
+    fillCircle(image, toImageX(0, view), toImageY(0, view), 7.f, red);
+}
+
+void encodePpm(const Image& image, std::vector<std::uint8_t>& out) {
+    std::string header = "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+    out.insert(out.end(), header.begin(), header.end());
+    out.insert(out.end(), image.pixels.begin(), image.pixels.end());
+}
+
+static std::uint32_t crc32(const std::uint8_t* data, size_t size, std::uint32_t crc = 0) {
+    static std::uint32_t table[256];
+    static bool ready = [] {
+        for (std::uint32_t n = 0; n < 256; n++) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)ready;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static std::uint32_t adler32(const std::uint8_t* data, size_t size) {
+    std::uint32_t a = 1, b = 0;
+    while (size > 0) {
+        //5552 bytes is the most that can be summed before b could overflow
+        size_t block = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < block; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+static void putBigEndian(std::vector<std::uint8_t>& out, std::uint32_t value) {
+    out.push_back((std::uint8_t)(value >> 24));
+    out.push_back((std::uint8_t)(value >> 16));
+    out.push_back((std::uint8_t)(value >> 8));
+    out.push_back((std::uint8_t)value);
+}
+
+//deflate writes bits from the least significant end, Huffman codes go in most significant bit first
+struct BitWriter {
+    std::vector<std::uint8_t>& out;
+    std::uint32_t bits = 0;
+    int count = 0;
+
+    void put(std::uint32_t value, int length) {
+        bits |= value << count;
+        count += length;
+        while (count >= 8) {
+            out.push_back((std::uint8_t)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+    void putCode(std::uint32_t code, int length) {
+        std::uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) reversed |= ((code >> i) & 1) << (length - 1 - i);
+        put(reversed, length);
+    }
+    void flush() {
+        if (count > 0) out.push_back((std::uint8_t)bits);
+        bits = 0;
+        count = 0;
+    }
+};
+
+static const int lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                     257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+//the fixed literal/length code of RFC 1951 3.2.6
+static void putFixedSymbol(BitWriter& writer, int symbol) {
+    if (symbol < 144) writer.putCode(0x30 + symbol, 8);
+    else if (symbol < 256) writer.putCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280) writer.putCode(symbol - 256, 7);
+    else writer.putCode(0xC0 + symbol - 280, 8);
+}
+
+static void putMatch(BitWriter& writer, int length, int distance) {
+    int l = 28;
+    while (lengthBase[l] > length) l--;
+    putFixedSymbol(writer, 257 + l);
+    if (lengthExtra[l]) writer.put(length - lengthBase[l], lengthExtra[l]);
+
+    int d = 29;
+    while (distanceBase[d] > distance) d--;
+    writer.putCode(d, 5);
+    if (distanceExtra[d]) writer.put(distance - distanceBase[d], distanceExtra[d]);
+}
+
+/*
+- One fixed Huffman block. The only matches tried are the pixel to the left and the pixel above,
+- which is where almost all of the redundancy of a plot on a flat background is, and each takes
+- one compare per byte; a general LZ77 search would cost far more for little gain here.
+*/
+static void deflateFixed(const std::vector<std::uint8_t>& data, int rowBytes, std::vector<std::uint8_t>& out) {
+    BitWriter writer{out};
+    writer.put(1, 1);   //last block
+    writer.put(1, 2);   //fixed Huffman codes
+
+    const int candidates[2] = {3, rowBytes};
+    size_t n = data.size();
+    size_t i = 0;
+    while (i < n) {
+        int bestLength = 0, bestDistance = 0;
+        for (int distance : candidates) {
+            if (distance > 32768 || (size_t)distance > i) continue;
+            size_t limit = std::min<size_t>(258, n - i);
+            const std::uint8_t* a = &data[i];
+            const std::uint8_t* b = a - distance;
+            size_t length = 0;
+            while (length < limit && a[length] == b[length]) length++;
+            if ((int)length > bestLength) {
+                bestLength = (int)length;
+                bestDistance = distance;
+            }
+        }
+        if (bestLength >= 3) {
+            putMatch(writer, bestLength, bestDistance);
+            i += bestLength;
+        } else {
+            putFixedSymbol(writer, data[i]);
+            i++;
+        }
+    }
+    putFixedSymbol(writer, 256);
+    writer.flush();
+}
+
+static void putChunk(std::vector<std::uint8_t>& out, const char* type, const std::vector<std::uint8_t>& data) {
+    putBigEndian(out, (std::uint32_t)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBigEndian(out, crc32(&out[start], out.size() - start));
+}
+
+void encodePng(const Image& image, std::vector<std::uint8_t>& out) {
+    static const std::uint8_t signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+
+    std::vector<std::uint8_t> header;
+    putBigEndian(header, (std::uint32_t)image.width);
+    putBigEndian(header, (std::uint32_t)image.height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});   //8 bit RGB, deflate, adaptive filters, no interlace
+    putChunk(out, "IHDR", header);
+
+    //every row starts with its filter type, 0 is none; the row above is a match candidate instead
+    int rowBytes = image.width * 3 + 1;
+    std::vector<std::uint8_t> raw((size_t)rowBytes * image.height);
+    for (int y = 0; y < image.height; y++) {
+        raw[(size_t)y * rowBytes] = 0;
+        std::copy(&image.pixels[(size_t)y * image.width * 3], &image.pixels[(size_t)(y + 1) * image.width * 3],
+                  &raw[(size_t)y * rowBytes + 1]);
+    }
+
+    std::vector<std::uint8_t> compressed = {0x78, 0x01};
+    deflateFixed(raw, rowBytes, compressed);
+    putBigEndian(compressed, adler32(raw.data(), raw.size()));
+    putChunk(out, "IDAT", compressed);
+    putChunk(out, "IEND", {});
+}
+
+bool writeImage(const Image& image, ImageFormat format, const std::string& filename) {
+    std::vector<std::uint8_t> data;
+    if (format == ImageFormat::Png) encodePng(image, data);
+    else encodePpm(image, data);
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Could not open " << filename << std::endl;
+        return false;
+    }
+    file.write((const char*)data.data(), data.size());
+    return (bool)file;
+}
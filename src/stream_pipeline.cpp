@@ -0,0 +1,272 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include "bounded_queue.h"
+#include "stream_pipeline.h"
+#include "replay.h"
+#include "operations.h"
+#include "quadtree.h"
+
+typedef std::chrono::steady_clock Clock;
+
+//one frame travelling through the stages
+struct StreamItem {
+    unsigned long sequence = 0;
+    const std::string* block = nullptr;
+    bool valid = false;
+    RawFrame raw;
+    FrameResult result;
+};
+
+typedef BoundedQueue<StreamItem*> ItemQueue;
+
+//spin a little, then yield, then sleep, so idle workers do not burn a core
+static void backoff(int& idle) {
+    idle++;
+    if (idle < 64) return;
+    if (idle < 128) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+static long long elapsedNs(Clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+}
+
+//shared state of one stage, its workers pop from in and push to out
+struct StageRuntime {
+    std::string name;
+    int workers = 1;
+    std::function<void(StreamItem&)> work;
+    ItemQueue* in = nullptr;
+    ItemQueue* out = nullptr;
+    const std::atomic<bool>* upstreamDone = nullptr;
+
+    std::atomic<bool> done{false};
+    std::atomic<int> active{0};
+    std::atomic<unsigned long> items{0};
+    std::atomic<long long> busyNs{0};
+    std::atomic<long long> blockedNs{0};
+    std::atomic<unsigned long long> depthSum{0};
+    std::atomic<size_t> depthMax{0};
+
+    //counts the input queue depth at the moment a frame is taken
+    void sampleDepth() {
+        size_t depth = in->size() + 1;
+        depthSum += depth;
+        size_t seen = depthMax.load(std::memory_order_relaxed);
+        while (depth > seen && !depthMax.compare_exchange_weak(seen, depth)) {}
+    }
+
+    //waits for room downstream, the time spent here is the backpressure this stage feels
+    void push(ItemQueue& queue, StreamItem* item) {
+        if (queue.tryPush(item)) return;
+        Clock::time_point start = Clock::now();
+        int idle = 0;
+        while (!queue.tryPush(item)) backoff(idle);
+        blockedNs += elapsedNs(start);
+    }
+
+    void run() {
+        int idle = 0;
+        while (true) {
+            StreamItem* item = nullptr;
+            if (!in->tryPop(item)) {
+                //upstream finished and nothing is left: this worker is done
+                bool finished = upstreamDone->load(std::memory_order_acquire);
+                if (!finished || !in->tryPop(item)) {
+                    if (finished) break;
+                    backoff(idle);
+                    continue;
+                }
+            }
+            idle = 0;
+            sampleDepth();
+
+            Clock::time_point start = Clock::now();
+            if (item->valid) work(*item);
+            busyNs += elapsedNs(start);
+            items++;
+
+            push(*out, item);
+        }
+        if (--active == 0) done.store(true, std::memory_order_release);
+    }
+
+    StageStats stats(double wallSeconds) const {
+        StageStats s;
+        s.name = name;
+        s.workers = workers;
+        s.items = items;
+        s.busySeconds = busyNs / 1e9;
+        s.blockedSeconds = blockedNs / 1e9;
+        s.utilization = wallSeconds > 0 ? s.busySeconds / (workers * wallSeconds) : 0;
+        s.queueDepthAvg = items ? (double)depthSum / items : 0;
+        s.queueDepthMax = depthMax;
+        s.queueCapacity = in->capacity();
+        return s;
+    }
+};
+
+StreamReport runStreamPipeline(const std::vector<std::string>& blocks, const PipelineConfig& config,
+                               const StreamConfig& stream,
+                               const std::function<void(const FrameResult&)>& onResult) {
+    StreamReport report;
+    report.frames = blocks.size();
+    if (blocks.empty()) return report;
+
+    //stage work, each step of processFrame on its own
+    std::vector<std::unique_ptr<StageRuntime>> stages;
+    auto addStage = [&stages](const std::string& name, int workers, std::function<void(StreamItem&)> work) {
+        stages.emplace_back(new StageRuntime());
+        stages.back()->name = name;
+        stages.back()->workers = workers > 0 ? workers : 1;
+        stages.back()->work = work;
+    };
+    addStage("parse", stream.parseWorkers, [](StreamItem& item) {
+        item.valid = readFrameBlock(*item.block, item.raw);
+        item.result.header = item.raw.header;
+        item.result.scan = item.raw.scan;
+    });
+    addStage("convert", stream.convertWorkers, [](StreamItem& item) {
+        //pooled frames keep their point buffer, so this only allocates while the pool warms up
+        item.result.points.resize(item.raw.ranges.size());
+        item.result.points.resize(convertToCarterisan(item.raw.ranges.data(), item.raw.ranges.size(),
+                                                      item.raw.scan, item.result.points.data()));
+    });
+    addStage("detect", stream.detectWorkers, [&config](StreamItem& item) {
+        Deadline deadline = Deadline::max();
+        if (config.detectionBudgetMs > 0)
+            deadline = Clock::now() + std::chrono::milliseconds(config.detectionBudgetMs);
+        detectLines(item.result.points, config.ransac, deadline, item.result.stats, item.result.lines);
+    });
+    addStage("intersect", stream.intersectWorkers, [&config](StreamItem& item) {
+        findValidIntersections(item.result.lines, item.result.points, config.minAngleThreshold,
+                               item.result.intersections);
+        buildDisplayTrees(config, item.result);
+    });
+
+    //one queue in front of every stage and one in front of the output
+    std::vector<std::unique_ptr<ItemQueue>> queues;
+    for (size_t i = 0; i <= stages.size(); i++) queues.emplace_back(new ItemQueue(stream.queueCapacity));
+
+    //enough frames to fill every queue and keep every worker busy; the free list is the source's backpressure
+    size_t poolSize = 0;
+    for (const auto& queue : queues) poolSize += queue->capacity();
+    for (const auto& stage : stages) poolSize += stage->workers;
+    std::vector<StreamItem> pool(poolSize);
+    ItemQueue freeItems(poolSize);
+    for (StreamItem& item : pool) freeItems.tryPush(&item);
+
+    std::atomic<bool> sourceDone{false};
+    for (size_t i = 0; i < stages.size(); i++) {
+        stages[i]->in = queues[i].get();
+        stages[i]->out = queues[i + 1].get();
+        stages[i]->upstreamDone = i == 0 ? &sourceDone : &stages[i - 1]->done;
+        stages[i]->active = stages[i]->workers;
+    }
+
+    //the source takes free frames, its blocked time is the backpressure reaching the input
+    StageRuntime source;
+    source.name = "source";
+    source.in = &freeItems;
+
+    //output stage runs on this thread, it has the queue after the last stage as input
+    StageRuntime output;
+    output.name = "output";
+    output.in = queues.back().get();
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (auto& stage : stages)
+        for (int w = 0; w < stage->workers; w++)
+            threads.emplace_back(&StageRuntime::run, stage.get());
+
+    //source: takes a free frame for each block, waits when every frame is in flight
+    threads.emplace_back([&]() {
+        for (size_t i = 0; i < blocks.size(); i++) {
+            StreamItem* item;
+            int idle = 0;
+            while (!freeItems.tryPop(item)) backoff(idle);
+            source.sampleDepth();
+            item->sequence = i;
+            item->block = &blocks[i];
+            item->valid = true;
+            source.items++;
+            source.push(*queues.front(), item);
+        }
+        sourceDone.store(true, std::memory_order_release);
+    });
+
+    //frames that finished early wait here until the ones before them are out
+    std::vector<StreamItem*> reorder(poolSize, nullptr);
+    unsigned long nextSequence = 0;
+    auto emit = [&](StreamItem* item) {
+        Clock::time_point begin = Clock::now();
+        if (item->valid) {
+            item->result.sequence = item->sequence + 1;
+            if (onResult) onResult(item->result);
+        }
+        else report.failed++;
+        output.busyNs += elapsedNs(begin);
+        output.items++;
+        freeItems.tryPush(item);
+    };
+
+    int idle = 0;
+    while (nextSequence < blocks.size()) {
+        StreamItem* item;
+        if (!output.in->tryPop(item)) {
+            backoff(idle);
+            continue;
+        }
+        idle = 0;
+        output.sampleDepth();
+
+        if (!stream.inOrder) {
+            emit(item);
+            nextSequence++;
+            continue;
+        }
+        reorder[item->sequence % poolSize] = item;
+        while (reorder[nextSequence % poolSize]) {
+            StreamItem* ready = reorder[nextSequence % poolSize];
+            reorder[nextSequence % poolSize] = nullptr;
+            emit(ready);
+            nextSequence++;
+        }
+    }
+
+    for (std::thread& thread : threads) thread.join();
+    report.wallSeconds = elapsedNs(start) / 1e9;
+    report.fps = report.wallSeconds > 0 ? (report.frames - report.failed) / report.wallSeconds : 0;
+
+    report.stages.push_back(source.stats(report.wallSeconds));
+    for (const auto& stage : stages) report.stages.push_back(stage->stats(report.wallSeconds));
+    report.stages.push_back(output.stats(report.wallSeconds));
+    return report;
+}
+
+void printStreamReport(const StreamReport& report) {
+    std::cout << "\n=== Stream Report ===" << std::endl;
+    std::cout << "Frames: " << report.frames << " (" << report.failed << " failed to parse) in "
+              << report.wallSeconds << " s, " << report.fps << " fps" << std::endl;
+    std::cout << std::left << std::setw(11) << "stage" << std::right
+              << std::setw(8) << "workers" << std::setw(8) << "items"
+              << std::setw(10) << "busy s" << std::setw(10) << "blocked s" << std::setw(8) << "util"
+              << std::setw(12) << "depth avg" << std::setw(12) << "depth max" << std::endl;
+    for (const StageStats& s : report.stages) {
+        std::cout << std::left << std::setw(11) << s.name << std::right << std::fixed
+                  << std::setw(8) << s.workers << std::setw(8) << s.items
+                  << std::setprecision(3) << std::setw(10) << s.busySeconds << std::setw(10) << s.blockedSeconds
+                  << std::setprecision(2) << std::setw(8) << s.utilization
+                  << std::setw(12) << s.queueDepthAvg
+                  << std::setw(8) << s.queueDepthMax << "/" << std::left << std::setw(3) << s.queueCapacity
+                  << std::right << std::defaultfloat << std::endl;
+    }
+}
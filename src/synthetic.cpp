@@ -0,0 +1,174 @@
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <iomanip>
+
+#include "synthetic.h"
+
+Scan syntheticScan() {
+    Scan scan;
+    scan.angle_min = -0.75 * M1_P;
+    scan.angle_max = 0.75 * M1_P;
+    scan.angle_increment = M1_P / 360;
+    scan.time_increment = 0;
+    scan.scan_time = 0.1;
+    scan.range_min = 0.2;
+    scan.range_max = 8.0;
+    return scan;
+}
+
+//closed polygon around the origin, rotated and shifted
+static void addPolygon(SyntheticScene& scene, const std::vector<Point2D>& corners,
+                       double yaw, double shiftX, double shiftY) {
+    std::vector<Point2D> placed;
+    for (const Point2D& p : corners) {
+        double x = p.x + shiftX, y = p.y + shiftY;
+        placed.push_back({x * std::cos(yaw) - y * std::sin(yaw), x * std::sin(yaw) + y * std::cos(yaw)});
+    }
+    for (size_t i = 0; i < placed.size(); i++)
+        scene.walls.push_back({placed[i], placed[(i + 1) % placed.size()]});
+}
+
+bool makeScene(const std::string& shape, unsigned seed, SyntheticScene& scene) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    double yaw = unit(gen) * 2 * M1_P;
+    scene.shape = shape;
+    scene.walls.clear();
+
+    if (shape == "room") {
+        //rectangle with the robot somewhere inside, at least half a metre from every wall
+        double w = 3 + 3 * unit(gen), h = 2.5 + 2.5 * unit(gen);
+        double x = 0.5 + (w - 1) * unit(gen), y = 0.5 + (h - 1) * unit(gen);
+        addPolygon(scene, {{0, 0}, {w, 0}, {w, h}, {0, h}}, yaw, -x, -y);
+    }
+    else if (shape == "lshape") {
+        //L shaped room, the robot stands in the long arm
+        double a = 4 + 2 * unit(gen), b = 1.5 + unit(gen), c = 1.5 + unit(gen), d = 3.5 + 2 * unit(gen);
+        double x = 0.5 + (c - 1) * unit(gen), y = 0.5 + (d - 1) * unit(gen);
+        addPolygon(scene, {{0, 0}, {a, 0}, {a, b}, {c, b}, {c, d}, {0, d}}, yaw, -x, -y);
+    }
+    else if (shape == "clutter") {
+        //room full of boxes and short wall pieces, many short lines and a lot of occlusion
+        double w = 6 + 2 * unit(gen), h = 5 + 2 * unit(gen);
+        double x = w / 2, y = h / 2;
+        addPolygon(scene, {{0, 0}, {w, 0}, {w, h}, {0, h}}, yaw, -x, -y);
+        for (int placed = 0, tries = 0; placed < 12 && tries < 200; tries++) {
+            double size = 0.25 + 0.4 * unit(gen);
+            double bx = 0.3 + (w - 0.6 - size) * unit(gen), by = 0.3 + (h - 0.6 - size) * unit(gen);
+            //keep the robot out of the boxes
+            if (std::hypot(bx + size / 2 - x, by + size / 2 - y) < size + 0.6) continue;
+            if (placed % 3 == 2) {
+                //a free standing wall piece
+                double angle = unit(gen) * M1_P, length = 0.5 + unit(gen);
+                addPolygon(scene, {{0, 0}, {length * std::cos(angle), length * std::sin(angle)}}, yaw, bx - x, by - y);
+                scene.walls.pop_back();     //the polygon closes back onto its start
+            } else {
+                addPolygon(scene, {{bx, by}, {bx + size, by}, {bx + size, by + size}, {bx, by + size}}, yaw, -x, -y);
+            }
+            placed++;
+        }
+    }
+    else if (shape == "corridor") {
+        //two long parallel walls, nothing for the intersection search to find
+        double width = 1.5 + unit(gen), length = 10;
+        double offset = (unit(gen) - 0.5) * (width - 0.6);
+        SyntheticWall left = {{-length / 2, width / 2}, {length / 2, width / 2}};
+        SyntheticWall right = {{-length / 2, -width / 2}, {length / 2, -width / 2}};
+        for (SyntheticWall wall : {left, right}) {
+            wall.a.y += offset;
+            wall.b.y += offset;
+            for (Point2D* p : {&wall.a, &wall.b})
+                *p = {p->x * std::cos(yaw) - p->y * std::sin(yaw), p->x * std::sin(yaw) + p->y * std::cos(yaw)};
+            scene.walls.push_back(wall);
+        }
+    }
+    else return false;
+    return true;
+}
+
+//distance along the ray to the wall, negative if the ray misses it
+static double rayToWall(double dx, double dy, const SyntheticWall& wall) {
+    double ex = wall.b.x - wall.a.x, ey = wall.b.y - wall.a.y;
+    double denom = dx * ey - dy * ex;
+    if (std::fabs(denom) < almostZero) return -1;
+    double t = (wall.a.x * ey - wall.a.y * ex) / denom;  //along the ray
+    double s = (wall.a.x * dy - wall.a.y * dx) / denom;  //along the wall
+    if (t <= 0 || s < 0 || s > 1) return -1;
+    return t;
+}
+
+SyntheticScene sceneFromPose(const SyntheticScene& scene, double x, double y, double yaw) {
+    SyntheticScene moved = scene;
+    double c = std::cos(-yaw), s = std::sin(-yaw);
+    for (SyntheticWall& wall : moved.walls) {
+        for (Point2D* p : {&wall.a, &wall.b}) {
+            double dx = p->x - x, dy = p->y - y;
+            p->x = c * dx - s * dy;
+            p->y = s * dx + c * dy;
+        }
+    }
+    return moved;
+}
+
+RawFrame renderScene(const SyntheticScene& scene, const Scan& scan, double noise, unsigned seed,
+                     int minPoints, GroundTruth& truth) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<> rangeNoise(0.0, noise);
+
+    RawFrame frame;
+    frame.header = {"synthetic-" + std::to_string(seed), scene.shape};
+    frame.scan = scan;
+    int beams = (int)std::floor((scan.angle_max - scan.angle_min) / scan.angle_increment) + 1;
+    frame.ranges.assign(beams, 999.0); //no return, the same marker the recorded logs use
+    truth = GroundTruth();
+    truth.wallHits.assign(scene.walls.size(), 0);
+
+    for (int i = 0; i < beams; i++) {
+        double angle = scan.angle_min + i * scan.angle_increment;
+        double dx = std::cos(angle), dy = std::sin(angle);
+        double nearest = -1;
+        int hitWall = -1;
+        for (size_t w = 0; w < scene.walls.size(); w++) {
+            double t = rayToWall(dx, dy, scene.walls[w]);
+            if (t > 0 && (nearest < 0 || t < nearest)) {
+                nearest = t;
+                hitWall = w;
+            }
+        }
+        if (hitWall < 0) continue;
+        double range = nearest + rangeNoise(gen);
+        if (range < scan.range_min || range > scan.range_max) continue;
+        frame.ranges[i] = range;
+        truth.wallHits[hitWall]++;
+    }
+
+    for (int hits : truth.wallHits)
+        if (hits >= minPoints) truth.lines++;
+    return frame;
+}
+
+std::string formatScanToml(const RawFrame& frame) {
+    std::ostringstream out;
+    //the range reader does not understand exponents, so everything is written in fixed notation
+    out << std::fixed << std::setprecision(6);
+    out << HEADER << "\n";
+    out << "stamp = \"" << frame.header.stamp << "\"\n";
+    out << "frame_id = \"" << frame.header.frame_id << "\"\n\n";
+    out << "[scan]\n";
+    out << "angle_min = " << frame.scan.angle_min << "\n";
+    out << "angle_max = " << frame.scan.angle_max << "\n";
+    out << "angle_increment = " << frame.scan.angle_increment << "\n\n";
+    out << "time_increment = " << frame.scan.time_increment << "\n";
+    out << "scan_time = " << frame.scan.scan_time << "\n\n";
+    out << "range_min = " << frame.scan.range_min << "\n";
+    out << "range_max = " << frame.scan.range_max << "\n\n";
+    out << std::setprecision(4);
+    out << "ranges = [\n";
+    for (size_t i = 0; i < frame.ranges.size(); i++) {
+        out << (i % 10 == 0 ? "  " : " ") << frame.ranges[i] << (i + 1 < frame.ranges.size() ? "," : "");
+        if (i % 10 == 9 || i + 1 == frame.ranges.size()) out << "\n";
+    }
+    out << "]\n";
+    return out.str();
+}
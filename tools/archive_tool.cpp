@@ -0,0 +1,115 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+
+#include "replay.h"
+#include "quantized.h"
+#include "scan_archive.h"
+
+/*
+- Packs a TOML scan log into a .lda archive and measures it
+- archive_tool pack <log.toml> <out.lda> [keyframe interval]
+- archive_tool bench <archive.lda>
+- bench compares decode speed with reading the same bytes from disk; a cold cache is the honest case
+*/
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::uint64_t fileSize(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    return file.is_open() ? (std::uint64_t)file.tellg() : 0;
+}
+
+static int pack(const std::string& input, const std::string& output, int keyframeInterval) {
+    std::vector<RawFrame> frames = readScanLog(input);
+    if (frames.empty()) {
+        std::cerr << "No frames in " << input << std::endl;
+        return 1;
+    }
+
+    ArchiveWriter writer;
+    if (!writer.open(output, keyframeInterval)) return 1;
+    std::uint64_t beams = 0;
+    std::vector<QuantizedFrame> packed(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        quantizeFrame(frames[i].header, frames[i].scan, frames[i].ranges, frames[i].intensities, packed[i]);
+        writer.write(packed[i]);
+        beams += frames[i].ranges.size();
+    }
+    if (!writer.close()) return 1;
+
+    //everything read back must match what was written
+    std::vector<QuantizedFrame> check = readScanArchive(output);
+    bool same = check.size() == packed.size();
+    for (size_t i = 0; same && i < check.size(); i++) {
+        same = check[i].ranges == packed[i].ranges && check[i].intensities == packed[i].intensities &&
+               check[i].header.stamp == packed[i].header.stamp;
+    }
+
+    std::uint64_t archiveBytes = fileSize(output);
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Frames: " << frames.size() << ", beams: " << beams << ", keyframe every " << keyframeInterval << std::endl;
+    std::cout << "Log: " << fileSize(input) << " bytes, archive: " << archiveBytes << " bytes ("
+              << (double)fileSize(input) / archiveBytes << "x)" << std::endl;
+    std::cout << "Bytes per beam: " << (double)archiveBytes / beams << " (uint16 frames: "
+              << 2.0 * (beams + beams) / beams << ")" << std::endl;
+    std::cout << "Round trip: " << (same ? "exact" : "MISMATCH") << std::endl;
+    return same ? 0 : 1;
+}
+
+static int bench(const std::string& filename) {
+    //plain read of the whole file, the speed the decoder has to beat
+    auto start = std::chrono::steady_clock::now();
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<char> bytes(fileSize(filename));
+    file.read(bytes.data(), bytes.size());
+    double readSeconds = secondsSince(start);
+
+    ArchiveReader reader;
+    if (!reader.open(filename)) return 1;
+    size_t frames = reader.frameCount();
+    QuantizedFrame frame;
+    std::uint64_t beams = 0;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frames; i++) {
+        if (!reader.next(frame)) {
+            std::cerr << "Decode failed at frame " << i << std::endl;
+            return 1;
+        }
+        beams += frame.ranges.size();
+    }
+    double decodeSeconds = secondsSince(start);
+
+    //random access, each read starts from the keyframe before the frame
+    const int seeks = 1000;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<size_t> pick(0, frames - 1);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < seeks; i++) reader.read(pick(rng), frame);
+    double seekSeconds = secondsSince(start);
+
+    double mb = bytes.size() / 1e6;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Frames: " << frames << ", " << bytes.size() << " bytes" << std::endl;
+    std::cout << "Read:   " << mb / readSeconds << " MB/s" << std::endl;
+    std::cout << "Decode: " << mb / decodeSeconds << " MB/s, " << frames / decodeSeconds << " frames/s, "
+              << beams / decodeSeconds / 1e6 << " M beams/s (includes file reads)" << std::endl;
+    std::cout << std::setprecision(3);
+    std::cout << "Random access: " << seekSeconds / seeks * 1000 << " ms per frame" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc >= 2 ? argv[1] : "";
+    if (mode == "pack" && argc >= 4) return pack(argv[2], argv[3], argc >= 5 ? std::stoi(argv[4]) : 30);
+    if (mode == "bench" && argc >= 3) return bench(argv[2]);
+    std::cerr << "Usage: archive_tool pack <log.toml> <out.lda> [keyframe interval]" << std::endl;
+    std::cerr << "       archive_tool bench <archive.lda>" << std::endl;
+    return 1;
+}
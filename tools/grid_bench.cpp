@@ -0,0 +1,85 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include "occupancy_grid.h"
+#include "operations.h"
+#include "synthetic.h"
+
+/*
+- Builds an occupancy grid from a synthetic robot driving around a room, with the true poses
+- Prints time per frame against the 25 ms a 40 Hz sensor allows, how many tiles each frame touched,
+- and how much of the walls ended up occupied; writes the map to grid_bench.pgm
+- grid_bench [frames] [room|lshape|corridor] [resolution]
+*/
+int main(int argc, char* argv[]) {
+    int frames = argc >= 2 ? std::stoi(argv[1]) : 400;
+    std::string shape = argc >= 3 ? argv[2] : "room";
+    OccupancyConfig config;
+    if (argc >= 4) config.resolution = std::stod(argv[3]);
+
+    SyntheticScene scene;
+    if (!makeScene(shape, 11, scene)) {
+        std::cerr << "Unknown shape: " << shape << std::endl;
+        return 1;
+    }
+
+    //scans rendered up front so only the map update is timed
+    std::vector<Pose2D> poses(frames);
+    std::vector<std::vector<Point2D>> scans(frames);
+    size_t beams = 0;
+    for (int i = 0; i < frames; i++) {
+        double phi = 2 * M1_P * i / frames;
+        poses[i].x = 0.25 * std::sin(phi);
+        poses[i].y = 0.25 - 0.25 * std::cos(phi);
+        poses[i].yaw = 3 * phi;
+        GroundTruth truth;
+        RawFrame raw = renderScene(sceneFromPose(scene, poses[i].x, poses[i].y, poses[i].yaw), syntheticScan(),
+                                   0.005, i, 8, truth);
+        scans[i].resize(raw.ranges.size());
+        scans[i].resize(convertToCarterisan(raw.ranges.data(), raw.ranges.size(), raw.scan, scans[i].data()));
+        beams += scans[i].size();
+    }
+
+    OccupancyGrid grid(config);
+    std::vector<double> frameMs;
+    double tilesTouched = 0;
+    for (int i = 0; i < frames; i++) {
+        auto start = std::chrono::steady_clock::now();
+        grid.integrate(poses[i], scans[i].data(), scans[i].size());
+        frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        tilesTouched += grid.frameTiles().size();
+    }
+    std::sort(frameMs.begin(), frameMs.end());
+
+    //a wall counts as mapped where the cell under it is occupied
+    int wallSamples = 0, wallOccupied = 0;
+    for (const SyntheticWall& wall : scene.walls) {
+        double length = std::hypot(wall.b.x - wall.a.x, wall.b.y - wall.a.y);
+        for (double t = 0; t <= length; t += config.resolution) {
+            double x = wall.a.x + (wall.b.x - wall.a.x) * t / length, y = wall.a.y + (wall.b.y - wall.a.y) * t / length;
+            if (std::hypot(x, y) > 8.0) continue;
+            wallSamples++;
+            //noise can put the hit in the cell next to the wall
+            bool occupied = false;
+            for (double dx = -config.resolution; dx <= config.resolution && !occupied; dx += config.resolution)
+                for (double dy = -config.resolution; dy <= config.resolution && !occupied; dy += config.resolution)
+                    occupied = grid.logOdds(x + dx, y + dy) > 0;
+            if (occupied) wallOccupied++;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Frames: " << frames << ", " << beams / frames << " beams each, " << config.resolution * 100
+              << " cm cells" << std::endl;
+    std::cout << "Integrate: p50 " << frameMs[frameMs.size() / 2] << " ms, p99 " << frameMs[frameMs.size() * 99 / 100]
+              << " ms, max " << frameMs.back() << " ms (40 Hz allows 25 ms)" << std::endl;
+    std::cout << "Tiles: " << grid.tileCount() << " in the map, " << tilesTouched / frames << " touched per frame" << std::endl;
+    std::cout << "Walls occupied: " << 100.0 * wallOccupied / std::max(wallSamples, 1) << "%" << std::endl;
+    writeMapPgm(grid, "grid_bench.pgm");
+    return 0;
+}
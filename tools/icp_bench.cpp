@@ -0,0 +1,78 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "scan_match.h"
+#include "operations.h"
+#include "synthetic.h"
+
+/*
+- Drives a robot around a small circle in a synthetic room and tracks it with ScanOdometry
+- Prints match time and iterations, and how far the odometry drifted from the true path
+- icp_bench [frames] [room|lshape|corridor] [noise in metres] [lines]
+- with "lines", each scan's detected walls are used for the reference lines, as ProcessingWorker does
+*/
+
+int main(int argc, char* argv[]) {
+    int frames = argc >= 2 ? std::stoi(argv[1]) : 120;
+    std::string shape = argc >= 3 ? argv[2] : "room";
+    double noise = argc >= 4 ? std::stod(argv[3]) : 0.005;
+    bool useLines = argc >= 5 && std::string(argv[4]) == "lines";
+
+    SyntheticScene scene;
+    if (!makeScene(shape, 11, scene)) {
+        std::cerr << "Unknown shape: " << shape << std::endl;
+        return 1;
+    }
+
+    //a quarter metre circle, the robot starts at the origin which is at least half a metre from every wall
+    const double radius = 0.25;
+    RANSACparameters ransac;
+    ransac.minPoints = 8;
+    ransac.distanceThreshold = std::max(0.01, 3 * noise);
+    ransac.maxIterations = 2000;
+
+    ScanOdometry odometry;
+    std::vector<double> matchMs;
+    double iterations = 0, pathLength = 0;
+    int failed = 0;
+    Pose2D truth, previous;
+    for (int i = 0; i < frames; i++) {
+        double phi = 2 * M1_P * i / frames;
+        truth.x = radius * std::sin(phi);
+        truth.y = radius - radius * std::cos(phi);
+        truth.yaw = phi;
+        if (i > 0) pathLength += std::hypot(truth.x - previous.x, truth.y - previous.y);
+        previous = truth;
+
+        GroundTruth wallTruth;
+        RawFrame raw = renderScene(sceneFromPose(scene, truth.x, truth.y, truth.yaw), syntheticScan(), noise, i, 8, wallTruth);
+        std::vector<Point2D> points(raw.ranges.size());
+        points.resize(convertToCarterisan(raw.ranges.data(), raw.ranges.size(), raw.scan, points.data()));
+        std::vector<Line> lines;
+        if (useLines) lines = detectLines(points, ransac);
+
+        IcpResult result = odometry.addScan(points, lines);
+        if (i == 0) continue;
+        if (!result.valid) failed++;
+        matchMs.push_back(result.elapsedMs);
+        iterations += result.iterations;
+    }
+
+    const Pose2D& estimate = odometry.pose();
+    double yawError = std::atan2(std::sin(estimate.yaw - truth.yaw), std::cos(estimate.yaw - truth.yaw));
+    double drift = std::hypot(estimate.x - truth.x, estimate.y - truth.y);
+    std::sort(matchMs.begin(), matchMs.end());
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Scene: " << shape << ", " << frames << " frames, noise " << noise * 1000 << " mm, reference lines from "
+              << (useLines ? "detected walls" : "beam neighbours") << std::endl;
+    std::cout << "Match: p50 " << matchMs[matchMs.size() / 2] << " ms, max " << matchMs.back() << " ms, "
+              << iterations / matchMs.size() << " iterations on average, " << failed << " failed" << std::endl;
+    std::cout << "Drift: " << drift * 1000 << " mm over " << pathLength << " m (" << 100 * drift / pathLength
+              << "%), yaw " << yawError * 180 / M1_P << " deg" << std::endl;
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include "replay.h"
+#include "net_ingest.h"
+
+/*
+- Test sender for the network ingest: plays a scan log over a local socket
+- lidar_sender <log.toml> [udp|tcp] [port] [speed] [loops]
+- speed 1 = paced by scan_time, 0 = as fast as possible; loops 0 = forever
+*/
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: lidar_sender <log.toml> [udp|tcp] [port] [speed] [loops]" << std::endl;
+        return -1;
+    }
+    IngestProtocol protocol = argc >= 3 && std::string(argv[2]) == "tcp" ? IngestProtocol::Tcp : IngestProtocol::Udp;
+    unsigned short port = argc >= 4 ? (unsigned short) std::stoi(argv[3]) : 5600;
+    double speed = argc >= 5 ? std::stod(argv[4]) : 1.0;
+    int loops = argc >= 6 ? std::stoi(argv[5]) : 1;
+
+    std::vector<RawFrame> frames = readScanLog(argv[1]);
+    if (frames.empty()) {
+        std::cerr << "No scans found in " << argv[1] << std::endl;
+        return -1;
+    }
+
+    //encode once, the same packets are sent on every loop
+    std::vector<std::vector<char>> packets(frames.size());
+    for (size_t i = 0; i < frames.size(); i++)
+        encodeScanPacket(frames[i].header, frames[i].scan, frames[i].ranges, i, packets[i]);
+
+    NetSender sender;
+    if (!sender.open(protocol, "127.0.0.1", port)) {
+        std::cerr << "Could not connect to port " << port << std::endl;
+        return -1;
+    }
+
+    std::vector<double> due = frameArrivalTimes(frames, speed);
+    unsigned long sent = 0;
+    for (int loop = 0; loops == 0 || loop < loops; loop++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < packets.size(); i++) {
+            if (speed > 0) std::this_thread::sleep_until(start + std::chrono::duration<double>(due[i]));
+            if (!sender.send(packets[i])) {
+                std::cerr << "Send failed after " << sent << " scans" << std::endl;
+                return -1;
+            }
+            sent++;
+        }
+        //the last scan still takes its scan_time before the log starts over
+        if (speed > 0) {
+            double last = frames.back().scan.scan_time > 0 ? frames.back().scan.scan_time : 0.1;
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(due.back() + last / speed));
+        }
+    }
+    std::cout << "Sent " << sent << " scans" << std::endl;
+    return 0;
+}
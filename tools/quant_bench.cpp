@@ -0,0 +1,68 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+
+#include "quantized.h"
+#include "operations.h"
+#include "synthetic.h"
+
+/*
+- Compares the double range path with the 16 bit one: memory per frame, conversion speed,
+- and that the SIMD decode gives the same points as the scalar one
+- quant_bench [beams] [rounds] [room|lshape|corridor]
+*/
+template <typename F>
+static double timeNsPerBeam(F convert, size_t beams, int rounds) {
+    auto start = std::chrono::steady_clock::now();
+    size_t sink = 0;
+    for (int r = 0; r < rounds; r++) sink += convert();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (sink == 42) std::cout << ""; //keeps the calls from being optimized away
+    return ns / rounds / beams;
+}
+
+int main(int argc, char* argv[]) {
+    size_t beams = argc >= 2 ? std::stoul(argv[1]) : 4096;
+    int rounds = argc >= 3 ? std::stoi(argv[2]) : 2000;
+
+    //a room scan with the requested number of beams
+    Scan scan = syntheticScan();
+    scan.angle_increment = (scan.angle_max - scan.angle_min) / (beams - 1);
+    SyntheticScene scene;
+    makeScene(argc >= 4 ? argv[3] : "room", 7, scene);
+    GroundTruth truth;
+    RawFrame raw = renderScene(scene, scan, 0.003, 7, 8, truth);
+    raw.ranges.resize(beams, 999.0);
+
+    QuantizedFrame quantized;
+    quantizeFrame(raw.header, raw.scan, raw.ranges, raw.intensities, quantized);
+
+    std::vector<Point2D> points(beams), simd(beams), scalar(beams);
+    size_t n = convertToCarterisan(raw.ranges.data(), beams, scan, points.data());
+    size_t nSimd = convertQuantized(quantized.ranges.data(), beams, quantized.rangeScale, scan, simd.data());
+    size_t nScalar = convertQuantizedScalar(quantized.ranges.data(), beams, quantized.rangeScale, scan, scalar.data());
+
+    double maxError = 0;
+    bool same = nSimd == nScalar && n == nSimd;
+    for (size_t i = 0; same && i < nSimd; i++) {
+        same = simd[i].x == scalar[i].x && simd[i].y == scalar[i].y;
+        maxError = std::max(maxError, std::hypot(simd[i].x - points[i].x, simd[i].y - points[i].y));
+    }
+
+    std::cout << "Beams: " << beams << ", points in range: " << n << std::endl;
+    std::cout << "Bytes per frame: " << beams * sizeof(double) << " as double, "
+              << beams * sizeof(std::uint16_t) << " as uint16" << std::endl;
+    std::cout << "SIMD matches scalar: " << (same ? "yes" : "NO") << ", largest error against double: "
+              << maxError * 1000 << " mm" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "double  convert:       " << timeNsPerBeam([&]() {
+        return convertToCarterisan(raw.ranges.data(), beams, scan, points.data()); }, beams, rounds) << " ns/beam" << std::endl;
+    std::cout << "uint16  scalar decode: " << timeNsPerBeam([&]() {
+        return convertQuantizedScalar(quantized.ranges.data(), beams, quantized.rangeScale, scan, scalar.data()); }, beams, rounds) << " ns/beam" << std::endl;
+    std::cout << "uint16  SIMD decode:   " << timeNsPerBeam([&]() {
+        return convertQuantized(quantized.ranges.data(), beams, quantized.rangeScale, scan, simd.data()); }, beams, rounds) << " ns/beam" << std::endl;
+    return same ? 0 : 1;
+}
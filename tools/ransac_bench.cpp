@@ -0,0 +1,107 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "operations.h"
+#include "synthetic.h"
+
+/*
+- Line detection on the same synthetic scans with and without the sequential early rejection test,
+- and with each way of sampling the candidate points, on the full budget and stopping at 99% confidence
+- Prints time and point checks per RANSAC iteration, how many candidates were scored in full or
+- dropped early, how many iterations it took to find each line, and how many
+- lines were found against the number of walls that were really there
+- ransac_bench [scans] [room|lshape|corridor|clutter] [max iterations] [noise] [sample window]
+*/
+struct BenchTotals {
+    double ms = 0;
+    long long iterations = 0;
+    long long scored = 0;
+    long long rejected = 0;
+    long long pointsTested = 0;
+    long long lines = 0;
+    long long iterationsToFind = 0;
+};
+
+static void printTotals(const std::string& name, const BenchTotals& t, int scans, int truthLines) {
+    std::cout << std::left << std::setw(18) << name << std::right
+              << std::setw(10) << t.ms / scans
+              << std::setw(12) << t.ms * 1000.0 / t.iterations
+              << std::setw(12) << (double)t.pointsTested / t.iterations
+              << std::setw(10) << 100.0 * t.scored / t.iterations
+              << std::setw(10) << 100.0 * t.rejected / t.iterations
+              << std::setw(11) << (double)t.iterationsToFind / t.lines
+              << std::setw(9) << (double)t.lines / scans << " / " << (double)truthLines / scans << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int scans = argc >= 2 ? std::stoi(argv[1]) : 50;
+    std::string shape = argc >= 3 ? argv[2] : "clutter";
+    RANSACparameters config;
+    config.minPoints = 8;
+    config.distanceThreshold = 0.01;
+    config.maxIterations = argc >= 4 ? std::stoi(argv[3]) : 5000;
+    double noise = argc >= 5 ? std::stod(argv[4]) : 0.003;
+    if (argc >= 6) config.sampleWindow = std::stoi(argv[5]);
+
+    //scans rendered up front, every mode sees the same points
+    std::vector<std::vector<Point2D>> clouds(scans);
+    int truthLines = 0;
+    size_t totalPoints = 0;
+    for (int i = 0; i < scans; i++) {
+        SyntheticScene scene;
+        if (!makeScene(shape, 100 + i, scene)) {
+            std::cerr << "Unknown shape: " << shape << std::endl;
+            return 1;
+        }
+        GroundTruth truth;
+        RawFrame raw = renderScene(scene, syntheticScan(), noise, i, config.minPoints, truth);
+        clouds[i].resize(raw.ranges.size());
+        clouds[i].resize(convertToCarterisan(raw.ranges.data(), raw.ranges.size(), raw.scan, clouds[i].data()));
+        truthLines += truth.lines;
+        totalPoints += clouds[i].size();
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << scans << " " << shape << " scans, " << totalPoints / scans << " points each, "
+              << config.maxIterations << " iterations per line" << std::endl;
+    std::cout << std::left << std::setw(18) << "mode" << std::right << std::setw(10) << "ms/scan" << std::setw(12)
+              << "us/iter" << std::setw(12) << "pts/iter" << std::setw(10) << "scored%" << std::setw(10)
+              << "early%" << std::setw(11) << "iter/line" << std::setw(9) << "lines" << " / truth" << std::endl;
+
+    struct Mode {
+        const char* name;
+        bool early;
+        SamplingMode sampling;
+        double confidence;
+    };
+    const Mode modes[] = {
+        {"full scoring", false, SamplingMode::Uniform, 0},
+        {"early rejection", true, SamplingMode::Uniform, 0},
+        {"early + local", true, SamplingMode::Local, 0},
+        {"uniform, 99% stop", true, SamplingMode::Uniform, 0.99},
+        {"local, 99% stop", true, SamplingMode::Local, 0.99},
+    };
+    for (const Mode& mode : modes) {
+        config.earlyRejection = mode.early;
+        config.sampling = mode.sampling;
+        config.confidence = mode.confidence;
+        BenchTotals totals;
+        for (const std::vector<Point2D>& points : clouds) {
+            RANSACstats stats;
+            auto start = std::chrono::steady_clock::now();
+            std::vector<Line> lines = detectLines(points, config, Deadline::max(), stats);
+            totals.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            totals.iterations += stats.iterations;
+            totals.scored += stats.candidatesScored;
+            totals.rejected += stats.rejectedEarly;
+            totals.pointsTested += stats.pointsTested;
+            totals.lines += lines.size();
+            totals.iterationsToFind += stats.iterationsToFind;
+        }
+        printTotals(mode.name, totals, scans, truthLines);
+    }
+    return 0;
+}
@@ -0,0 +1,341 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "file_read.h"
+#include "replay.h"
+#include "synthetic.h"
+
+/*
+- Regression harness: runs the whole pipeline, log text to intersections, over a corpus of scans
+- regress <manifest> [--baseline file] [--save file] [--threshold percent] [--repeat n] [--iterations n]
+- Reports per frame latency percentiles, frames per second, peak memory and detection quality,
+- and fails (exit code 1) when a number got worse than the baseline by more than the threshold,
+- or when a scan does not give the intersection count its manifest line expects.
+- Manifest lines, paths relative to the manifest:
+-   file <path> [lines] [intersections]     recorded log, "-" or nothing skips a quality check
+-   synthetic <room|lshape|corridor> <seed> [frames]
+- Synthetic scans only check lines. isOnSegment takes a corner only where the two inlier spans cross,
+- and on noise free walls they stop short of each other, so no true corner there is ever found.
+- Intersections are checked on recorded logs.
+*/
+#define SYNTHETIC_NOISE 0.003   //range noise of the synthetic scans, metres
+#define QUALITY_TOLERANCE 0.05  //absolute rise in line or intersection error that fails the run
+
+//one scan and what should be found in it
+struct CorpusFrame {
+    std::string text;
+    int expectedLines = -1;             //-1 means unknown
+    int expectedIntersections = -1;
+};
+
+struct CorpusEntry {
+    std::string name;
+    std::vector<CorpusFrame> frames;
+};
+
+//numbers kept in the baseline file; latency and memory should not grow, the rest should not shrink
+struct RegressMetrics {
+    double p50Ms = 0;
+    double p95Ms = 0;
+    double p99Ms = 0;
+    double fps = 0;
+    double peakRssKb = 0;
+    double lineError = 0;           //mean |found - expected| lines per checked frame
+    double intersectionError = 0;   //mean |found - expected| intersections per checked frame
+};
+
+static double peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize / 1024.0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss; //kilobytes on Linux
+#endif
+}
+
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t idx = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static int parseExpected(std::istringstream& fields) {
+    std::string value;
+    if (!(fields >> value) || value == "-") return -1;
+    return std::stoi(value);
+}
+
+static bool loadCorpus(const std::string& manifest, int minPoints, std::vector<CorpusEntry>& corpus) {
+    std::ifstream file(manifest);
+    if (!file.is_open()) {
+        std::cerr << "Manifest could not be opened: " << manifest << std::endl;
+        return false;
+    }
+    std::string dir = manifest.substr(0, manifest.find_last_of("/\\") + 1);
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        std::istringstream fields(line);
+        std::string kind;
+        if (!(fields >> kind) || kind[0] == '#') continue;
+
+        CorpusEntry entry;
+        if (kind == "file") {
+            std::string path;
+            fields >> path;
+            int lines = parseExpected(fields);
+            int intersections = parseExpected(fields);
+            bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\' || path.find(':') == 1);
+            for (const std::string& block : readFrameBlocks(absolute ? path : dir + path)) {
+                CorpusFrame frame;
+                frame.text = block;
+                frame.expectedLines = lines;
+                frame.expectedIntersections = intersections;
+                entry.frames.push_back(frame);
+            }
+            entry.name = path;
+        }
+        else if (kind == "synthetic") {
+            std::string shape;
+            unsigned seed = 1;
+            int count = 10;
+            fields >> shape >> seed >> count;
+            SyntheticScene scene;
+            if (!makeScene(shape, seed, scene)) {
+                std::cerr << "Unknown synthetic shape: " << shape << std::endl;
+                return false;
+            }
+            for (int i = 0; i < count; i++) {
+                GroundTruth truth;
+                RawFrame raw = renderScene(scene, syntheticScan(), SYNTHETIC_NOISE, seed * 1000 + i, minPoints, truth);
+                CorpusFrame frame;
+                frame.text = formatScanToml(raw);
+                frame.expectedLines = truth.lines;
+                entry.frames.push_back(frame);
+            }
+            entry.name = shape + " " + std::to_string(seed);
+        }
+        else {
+            std::cerr << "Unknown manifest entry: " << line << std::endl;
+            return false;
+        }
+
+        if (entry.frames.empty()) {
+            std::cerr << "No scans for manifest entry: " << line << std::endl;
+            return false;
+        }
+        corpus.push_back(entry);
+    }
+    return true;
+}
+
+//key = value lines, the same style as the scan files
+static bool loadBaseline(const std::string& filename, RegressMetrics& m) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+    std::map<std::string, double*> keys = {
+        {"p50_ms", &m.p50Ms}, {"p95_ms", &m.p95Ms}, {"p99_ms", &m.p99Ms}, {"fps", &m.fps},
+        {"peak_rss_kb", &m.peakRssKb}, {"line_error", &m.lineError},
+        {"intersection_error", &m.intersectionError}};
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t pos = line.find('=');
+        if (line.empty() || line[0] == '#' || pos == std::string::npos) continue;
+        std::string key = line.substr(0, pos);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        auto it = keys.find(key);
+        if (it != keys.end()) *it->second = std::stod(line.substr(pos + 1));
+    }
+    return true;
+}
+
+static bool saveBaseline(const std::string& filename, const RegressMetrics& m) {
+    std::ofstream file(filename);
+    if (!file.is_open()) return false;
+    file << "# regress baseline\n" << std::fixed << std::setprecision(4);
+    file << "p50_ms = " << m.p50Ms << "\n";
+    file << "p95_ms = " << m.p95Ms << "\n";
+    file << "p99_ms = " << m.p99Ms << "\n";
+    file << "fps = " << m.fps << "\n";
+    file << "peak_rss_kb = " << m.peakRssKb << "\n";
+    file << "line_error = " << m.lineError << "\n";
+    file << "intersection_error = " << m.intersectionError << "\n";
+    return file.good();
+}
+
+//prints one comparison row, returns false if the value moved the wrong way by more than allowed
+//timings and memory are compared in percent, quality numbers by absolute difference
+static bool compare(const std::string& name, double now, double base, bool higherIsBetter,
+                    double allowed, bool relative = true) {
+    double change = base != 0 ? (now - base) / std::fabs(base) * 100 : 0;
+    double moved = relative ? change : now - base;
+    bool worse = higherIsBetter ? moved < -allowed : moved > allowed;
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << base << std::setw(12) << now
+              << std::setprecision(1) << std::setw(9) << change << "%"
+              << (worse ? "  REGRESSION" : "") << std::defaultfloat << std::endl;
+    return !worse;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: regress <manifest> [--baseline file] [--save file] [--threshold percent] [--repeat n] [--iterations n]" << std::endl;
+        return -1;
+    }
+    std::string baselineFile, saveFile;
+    double threshold = 10;
+    int repeat = 3;
+
+    //same settings the viewer uses, so the numbers mean the same thing
+    PipelineConfig config;
+    config.ransac.minPoints = 8;
+    config.ransac.distanceThreshold = 0.01;
+    config.ransac.maxIterations = 10*10000;
+    config.ransac.earlyRejection = true;
+    config.minAngleThreshold = 60.0;
+    config.detectionBudgetMs = 500;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--baseline") baselineFile = argv[i + 1];
+        else if (option == "--save") saveFile = argv[i + 1];
+        else if (option == "--threshold") threshold = std::stod(argv[i + 1]);
+        else if (option == "--repeat") repeat = std::stoi(argv[i + 1]);
+        else if (option == "--iterations") config.ransac.maxIterations = std::stoi(argv[i + 1]);
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return -1;
+        }
+    }
+
+    std::vector<CorpusEntry> corpus;
+    if (!loadCorpus(argv[1], config.ransac.minPoints, corpus)) return -1;
+
+    std::vector<double> latencies;
+    double totalSeconds = 0;
+    double lineErrorSum = 0, intersectionErrorSum = 0;
+    int lineChecks = 0, intersectionChecks = 0;
+    int countMismatches = 0, missedAll = 0, unreadable = 0;
+
+    std::cout << std::left << std::setw(28) << "entry" << std::right << std::setw(8) << "frames"
+              << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+              << std::setw(12) << "lines" << std::setw(12) << "inters" << std::endl;
+    RawFrame raw;
+    FrameResult result;
+    for (const CorpusEntry& entry : corpus) {
+        std::vector<double> entryLatencies;
+        double foundLines = 0, expectedLines = 0, foundInters = 0, expectedInters = 0;
+
+        for (int r = 0; r < repeat; r++) {
+            for (const CorpusFrame& frame : entry.frames) {
+                //timed from the text of the scan until the intersections are known
+                auto start = std::chrono::steady_clock::now();
+                if (!readFrameBlock(frame.text, raw)) {
+                    unreadable++;
+                    continue;
+                }
+                processFrame(raw, config, result);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                entryLatencies.push_back(seconds * 1000);
+                totalSeconds += seconds;
+
+                foundLines += result.lines.size();
+                foundInters += result.intersections.size();
+                if (frame.expectedLines >= 0) {
+                    lineErrorSum += std::abs((int)result.lines.size() - frame.expectedLines);
+                    lineChecks++;
+                    expectedLines += frame.expectedLines;
+                }
+                if (frame.expectedIntersections >= 0) {
+                    int found = result.intersections.size();
+                    intersectionErrorSum += std::abs(found - frame.expectedIntersections);
+                    intersectionChecks++;
+                    expectedInters += frame.expectedIntersections;
+                    if (found != frame.expectedIntersections) countMismatches++;
+                    //a detector that stopped finding intersections altogether gets its own line in the report
+                    if (found == 0 && frame.expectedIntersections > 0) missedAll++;
+                }
+            }
+        }
+
+        latencies.insert(latencies.end(), entryLatencies.begin(), entryLatencies.end());
+        std::sort(entryLatencies.begin(), entryLatencies.end());
+        int runs = entry.frames.size() * repeat;
+        std::ostringstream lines, inters;
+        lines << std::fixed << std::setprecision(1) << foundLines / runs << "/";
+        inters << std::fixed << std::setprecision(1) << foundInters / runs << "/";
+        if (expectedLines > 0 || entry.frames[0].expectedLines == 0) lines << expectedLines / runs; else lines << "-";
+        if (expectedInters > 0 || entry.frames[0].expectedIntersections == 0) inters << expectedInters / runs; else inters << "-";
+        std::cout << std::left << std::setw(28) << entry.name << std::right << std::setw(8) << entry.frames.size()
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(10) << percentile(entryLatencies, 0.5) << std::setw(10) << percentile(entryLatencies, 0.99)
+                  << std::setw(12) << lines.str() << std::setw(12) << inters.str() << std::defaultfloat << std::endl;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    RegressMetrics now;
+    now.p50Ms = percentile(latencies, 0.50);
+    now.p95Ms = percentile(latencies, 0.95);
+    now.p99Ms = percentile(latencies, 0.99);
+    now.fps = totalSeconds > 0 ? latencies.size() / totalSeconds : 0;
+    now.peakRssKb = peakRssKb();
+    now.lineError = lineChecks ? lineErrorSum / lineChecks : 0;
+    now.intersectionError = intersectionChecks ? intersectionErrorSum / intersectionChecks : 0;
+
+    std::cout << "\n=== Regression Run ===" << std::endl << std::setprecision(4);
+    std::cout << "Frames: " << latencies.size() << ", p50 " << now.p50Ms << " ms, p95 " << now.p95Ms
+              << " ms, p99 " << now.p99Ms << " ms, " << now.fps << " fps, peak RSS " << now.peakRssKb / 1024 << " MB" << std::endl;
+    std::cout << "Quality: line error " << now.lineError << " over " << lineChecks << " scans, intersection error "
+              << now.intersectionError << " over " << intersectionChecks << " scans" << std::endl;
+    if (intersectionChecks == 0) std::cout << "No scan in the corpus has an expected intersection count" << std::endl;
+    if (countMismatches) std::cout << "Scans with a different intersection count: " << countMismatches << std::endl;
+    if (missedAll) std::cout << "Scans with no intersections where some were expected: " << missedAll << std::endl;
+    if (unreadable) std::cout << "Scans that could not be read: " << unreadable << std::endl;
+
+    bool pass = countMismatches == 0 && unreadable == 0;
+    RegressMetrics base;
+    if (!baselineFile.empty()) {
+        if (!loadBaseline(baselineFile, base)) {
+            std::cerr << "Baseline could not be read: " << baselineFile << std::endl;
+            return -1;
+        }
+        std::cout << "\n" << std::left << std::setw(18) << "metric" << std::right << std::setw(12) << "baseline"
+                  << std::setw(12) << "now" << std::setw(10) << "change" << "  (threshold " << threshold << "%)" << std::endl;
+        pass &= compare("p50 ms", now.p50Ms, base.p50Ms, false, threshold);
+        pass &= compare("p95 ms", now.p95Ms, base.p95Ms, false, threshold);
+        pass &= compare("p99 ms", now.p99Ms, base.p99Ms, false, threshold);
+        pass &= compare("fps", now.fps, base.fps, true, threshold);
+        pass &= compare("peak RSS kb", now.peakRssKb, base.peakRssKb, false, threshold);
+        //RANSAC is random, so quality gets a small absolute tolerance; a faster build must not find less
+        pass &= compare("line error", now.lineError, base.lineError, false, QUALITY_TOLERANCE, false);
+        pass &= compare("intersection error", now.intersectionError, base.intersectionError, false, QUALITY_TOLERANCE, false);
+    }
+
+    if (!saveFile.empty()) {
+        if (saveBaseline(saveFile, now)) std::cout << "Baseline saved to " << saveFile << std::endl;
+        else std::cerr << "Baseline could not be written: " << saveFile << std::endl;
+    }
+
+    std::cout << (pass ? "PASS" : "FAIL") << std::endl;
+    return pass ? 0 : 1;
+}
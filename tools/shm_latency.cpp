@@ -0,0 +1,63 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "shm_ring.h"
+#include "pipeline.h"
+
+/*
+- End-to-end latency of the shared memory path, run it next to shm_writer
+- shm_latency [name] [frames]
+- handoff = driver commit until points are ready, total = until lines and intersections are ready
+*/
+static double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) return 0;
+    std::sort(samples.begin(), samples.end());
+    size_t idx = (size_t)(fraction * (samples.size() - 1) + 0.5);
+    return samples[std::min(idx, samples.size() - 1)];
+}
+
+static void printRow(const std::string& name, const std::vector<double>& samples) {
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << percentile(samples, 0.5)
+              << std::setw(10) << percentile(samples, 0.99)
+              << std::setw(10) << percentile(samples, 1.0) << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string name = argc >= 2 ? argv[1] : shmDefaultName;
+    int frames = argc >= 3 ? std::stoi(argv[2]) : 1000;
+
+    ShmRingReader reader;
+    if (!reader.open(name)) return -1;
+
+    PipelineConfig config;
+    config.detectionBudgetMs = 50;
+    FrameResult result;
+    std::vector<double> handoff, total;
+    handoff.reserve(frames);
+    total.reserve(frames);
+
+    int misses = 0;
+    while ((int)handoff.size() < frames && misses < 100) {
+        if (!reader.readLatest(result.header, result.scan, result.points, 100)) {
+            misses++;
+            continue;
+        }
+        misses = 0;
+        std::int64_t readDone = steadyNowNs();
+        processPoints(config, result);
+        handoff.push_back(reader.lastLatencyMs());
+        total.push_back(reader.lastLatencyMs() + (steadyNowNs() - readDone) / 1e6);
+    }
+
+    std::cout << "Frames read: " << reader.framesRead() << ", skipped: " << reader.framesSkipped()
+              << ", torn reads: " << reader.tornReads() << std::endl;
+    std::cout << std::left << std::setw(10) << "ms" << std::right
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+    printRow("handoff", handoff);
+    printRow("total", total);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include "replay.h"
+#include "shm_ring.h"
+
+/*
+- Stand-in lidar driver: plays a scan log into the shared memory ring
+- shm_writer <log.toml> [name] [speed] [loops]
+- speed 1 = paced by scan_time, N = N times faster, 0 = as fast as possible; loops 0 = forever
+*/
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: shm_writer <log.toml> [name] [speed] [loops]" << std::endl;
+        return -1;
+    }
+    std::string name = argc >= 3 ? argv[2] : shmDefaultName;
+    double speed = argc >= 4 ? std::stod(argv[3]) : 1.0;
+    int loops = argc >= 5 ? std::stoi(argv[4]) : 0;
+
+    std::vector<RawFrame> frames = readScanLog(argv[1]);
+    if (frames.empty()) {
+        std::cerr << "No scans found in " << argv[1] << std::endl;
+        return -1;
+    }
+
+    ShmRingWriter writer;
+    if (!writer.create(name)) return -1;
+    std::cout << "Writing " << frames.size() << " scans into " << name << std::endl;
+
+    std::vector<double> due = frameArrivalTimes(frames, speed);
+    unsigned long written = 0;
+    for (int loop = 0; loops == 0 || loop < loops; loop++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < frames.size(); i++) {
+            if (speed > 0) std::this_thread::sleep_until(start + std::chrono::duration<double>(due[i]));
+            //a real driver would fill the slot from beginFrame directly
+            if (!writer.writeFrame(frames[i].header, frames[i].scan, frames[i].ranges)) {
+                std::cerr << "Scan " << i << " does not fit in a slot" << std::endl;
+                return -1;
+            }
+            written++;
+        }
+        //the last scan still takes its scan_time before the log starts over
+        if (speed > 0) {
+            double last = frames.back().scan.scan_time > 0 ? frames.back().scan.scan_time : 0.1;
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(due.back() + last / speed));
+        }
+    }
+    std::cout << "Wrote " << written << " scans" << std::endl;
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+
+#include "replay.h"
+#include "pipeline.h"
+#include "snapshot.h"
+
+/*
+- Processes every frame of a log and saves what the window would show for it, without a display
+- snapshot_tool <log.toml|log.lda> <directory> [png|ppm] [threads] [pixels per metre]
+- Writes frame_00000.png ... ; frames are handed out to the threads one at a time, each thread keeps
+- its own result, image and encode buffer so nothing is shared but the frame counter
+*/
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: snapshot_tool <log> <directory> [png|ppm] [threads] [pixels per metre]" << std::endl;
+        return 1;
+    }
+    std::string directory = argv[2];
+    ImageFormat format = argc >= 4 && std::string(argv[3]) == "ppm" ? ImageFormat::Ppm : ImageFormat::Png;
+    int threads = argc >= 5 ? std::stoi(argv[4]) : (int)std::max(1u, std::thread::hardware_concurrency());
+    SnapshotView view;
+    if (argc >= 6) view.scale = std::stod(argv[5]);
+
+    std::vector<QuantizedFrame> frames = readScanLogQuantized(argv[1]);
+    if (frames.empty()) {
+        std::cerr << "No frames in " << argv[1] << std::endl;
+        return 1;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    //same settings as the window, including its detection budget
+    PipelineConfig config;
+    config.ransac.minPoints = 8;
+    config.ransac.distanceThreshold = 0.01;
+    config.ransac.maxIterations = 10*10000;
+    config.ransac.earlyRejection = true;
+    config.minAngleThreshold = 60.0;
+    config.buildTrees = true;
+
+    std::atomic<size_t> next{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<int> failed{0};
+    std::vector<double> processSeconds(threads, 0), renderSeconds(threads, 0), writeSeconds(threads, 0);
+    const char* extension = format == ImageFormat::Png ? "png" : "ppm";
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            FrameResult result;
+            Image image;
+            std::vector<std::uint8_t> encoded;
+            char name[32];
+            for (size_t i = next++; i < frames.size(); i = next++) {
+                auto stageStart = std::chrono::steady_clock::now();
+                processQuantizedFrame(frames[i], config, result);
+                processSeconds[t] += secondsSince(stageStart);
+
+                stageStart = std::chrono::steady_clock::now();
+                renderSnapshot(result, view, image);
+                encoded.clear();
+                if (format == ImageFormat::Png) encodePng(image, encoded);
+                else encodePpm(image, encoded);
+                renderSeconds[t] += secondsSince(stageStart);
+
+                stageStart = std::chrono::steady_clock::now();
+                std::snprintf(name, sizeof(name), "frame_%05zu.%s", i, extension);
+                FILE* file = std::fopen((directory + "/" + name).c_str(), "wb");
+                if (!file || std::fwrite(encoded.data(), 1, encoded.size(), file) != encoded.size()) failed++;
+                if (file) std::fclose(file);
+                bytes += encoded.size();
+                writeSeconds[t] += secondsSince(stageStart);
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    double total = secondsSince(start);
+
+    double process = 0, render = 0, write = 0;
+    for (int t = 0; t < threads; t++) {
+        process += processSeconds[t];
+        render += renderSeconds[t];
+        write += writeSeconds[t];
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Frames: " << frames.size() << " on " << threads << " threads, " << view.width << "x" << view.height
+              << " " << extension << std::endl;
+    std::cout << "Total: " << total << " s, " << frames.size() * 60.0 / total << " frames per minute" << std::endl;
+    std::cout << "Per frame: processing " << process * 1000.0 / frames.size() << " ms, render and encode "
+              << render * 1000.0 / frames.size() << " ms, write " << write * 1000.0 / frames.size() << " ms" << std::endl;
+    std::cout << "Output: " << bytes / frames.size() << " bytes per image in " << directory << std::endl;
+    if (failed) std::cerr << failed << " images could not be written" << std::endl;
+    return failed ? 1 : 0;
+}